@@ -9,8 +9,10 @@
 // structure for candidates
 typedef struct {
     void *dlib;     // dynamic library
+    char *file;     // path of the library
     char *name;     // name of cipher
     int keybytes, nsecbytes, npubbytes, abytes, nooverlap;
+    int crashed;    // has crashed in-process, run tests in a child
 
     int (*encrypt)(unsigned char *c, unsigned long long *clen,
         const unsigned char *m, unsigned long long mlen,
@@ -24,22 +26,204 @@ typedef struct {
         const unsigned char *npub, const unsigned char *k);
 } caesar_t;
 
+// test buffers, see arena.c
+#define ARENA_BUFS      8
+#define ARENA_ALIGN     64              // at least a cache line
+#define ARENA_HUGE      0x200000        // hugepage size
+
+typedef struct {
+    uint8_t *key, *nsec, *osec, *npub, *pt, *xt, *ad, *ct;
+    size_t mlen, adlen;                 // capacity of pt / xt and ad
+    void *base;
+    size_t size;
+} arena_t;
+
+// list of message / associated data lengths
+typedef struct {
+    int n;
+    unsigned long long *len;
+} lenlist_t;
+
+#define LENLIST_MAX     0x10000         // lengths in a list
+
+// output formats
+#define FORMAT_TEXT     0
+#define FORMAT_CSV      1
+#define FORMAT_JSON     2
+
+// a test and its parameter, for the job scheduler
+typedef struct {
+    int (*func)(caesar_t *, int);
+    int val;
+} sched_test_t;
+
 // global flags
 extern int brutus_verbose;
+extern int brutus_format;
+extern lenlist_t brutus_mlens, brutus_adlens;
+
+// timer types
+#define TIMER_CLOCK     0       // clock(), process time
+#define TIMER_MONO      1       // clock_gettime(CLOCK_MONOTONIC_RAW)
+#define TIMER_TSC       2       // serialized rdtsc / rdtscp
+#define TIMER_PERF      3       // perf_event core cycles
+#define TIMER_TYPES     4
+
+// alignment test flags relative slowdowns larger than this
+#define ALIGN_SLOW      0.10
+
+// baseline comparison flags slowdowns larger than this; without
+// repetitions (no confidence intervals) only larger than noise level
+#define RESULTS_SLOW    0.03
+#define RESULTS_NOISE   0.10
+
+// warn if core clock and reference clock disagree by more than this
+#define TIMER_DRIFT_MAX 0.03
+
+// hardware counters, see pmu.c
+#define PMU_CYCLES      0
+#define PMU_INSNS       1
+#define PMU_L1DMISS     2
+#define PMU_LLCMISS     3
+#define PMU_BRMISS      4
+#define PMU_STALLFE     5
+#define PMU_STALLBE     6
+#define PMU_EVENTS      7
+
+extern int brutus_timer;
+extern int brutus_reps;
+extern int brutus_threads;
+extern int brutus_hugepages;
+extern const char *brutus_mix;
+extern int brutus_pmu;
+extern const char *brutus_db;
+extern const char *brutus_best;
+extern int brutus_inproc;
+extern int brutus_watched;
+extern double brutus_tlimit;
+extern int brutus_detseq;
+
+// in-process test isolation and watchdog, see util.c
+#define HARNESS_SIGS    6               // signals caught
+#define HARNESS_STACK   0x10000         // alternate signal stack
+#define HARNESS_TIMEOUT SIGVTALRM       // in-process watchdog signal
+
+// deterministic sequence versions (-g), see util.c and gen.c
+#define DETSEQ_FIB      0               // Fibonacci; the original KATs
+#define DETSEQ_CTR      1               // counter-based, vectorized
+#define DETSEQ_MAX      1
+
+// key of the counter-based generator
+typedef struct {
+    uint32_t k0, k1;
+} gen_t;
+
+#define GEN_K0          0x9E3779B9      // k0 of seed 0
+
+// FNV-1a offset basis
+#define HASH_FNV_INIT   0xCBF29CE484222325LLU
+
+// statistics of repeated measurements
+typedef struct {
+    int n, kept;            // samples, samples after outlier rejection
+    double min, med, p90, max;
+    double lo, hi;          // 95% bootstrap confidence interval of median
+} stats_t;
 
 // util.c prototypes
 void detseq_seed(uint32_t seed);
 uint32_t detseq32();
-void detseq_fill(void *p, int len);
+void detseq_fill(void *p, size_t len);
+uint64_t hash_fnv(uint64_t h, const void *p, size_t len);
 void hex_dump(void *p, int len);
 double plg2chi2(double chi2);
+int name_prefix(const char *name);
+int parse_lengths(lenlist_t *lst, const char *spec);
 int test_harness(int (*test_func)(caesar_t *, int), caesar_t *aead, int val);
+double harness_now();
+void harness_deadline(double sec);
+double harness_left();
+void harness_plan(double units);
+double harness_unit();
+void harness_spend(double units);
+void harness_budget(double sec);
+
+// gen.c prototypes
+void gen_key(gen_t *g, uint32_t seed);
+uint32_t gen_word(const gen_t *g, uint64_t n);
+void gen_words(const gen_t *g, uint64_t n, void *out, size_t cnt);
+void gen_fill(const gen_t *g, uint64_t off, void *p, size_t len);
+
+// timer.c prototypes
+int timer_init(int type);
+uint64_t timer_start();
+uint64_t timer_read();
+uint64_t timer_stop();
+double timer_drift();
+double timer_sec(double ticks);
+uint64_t timer_ticks(double sec);
+double timer_cycles(double ticks);
+const char *timer_name();
+
+// pmu.c prototypes
+int pmu_init();
+void pmu_start();
+int pmu_stop(double *cnt);
+
+// results.c prototypes
+void results_init();
+int results_load(const char *fn);
+void results_record(caesar_t *aead, const char *op,
+                    unsigned long long mlen, unsigned long long adlen,
+                    int n, double med, double lo, double hi, double kbps);
+
+// arena.c prototypes
+int arena_alloc(arena_t *ar, caesar_t *aead, size_t mlen, size_t adlen);
+void arena_free(arena_t *ar);
+
+// best.c prototypes
+int best_run(caesar_t *cand, int ciphers, int limit);
+
+// bundle.c prototypes (brutus-bundle only, see mkbundle.sh)
+int bundle_size();
+int bundle_find(caesar_t *cand, const char *pattern);
+
+// sched.c prototypes
+int sched_run(caesar_t *cand, int ciphers, sched_test_t *test, int ntests,
+            int jobs);
+
+// stats.c prototypes
+double stats_quantile(const double *x, int n, double q);
+void stats_calc(stats_t *st, double *x, int n);
+void stats_linfit(const double *x, const double *y, int n,
+                double *a, double *b);
 
 // test modules
+void speed_header();
+void speed_row(caesar_t *aead, const char *timer, const char *op,
+                unsigned long long mlen, unsigned long long adlen,
+                unsigned long long calls, double sec, const stats_t *st,
+                const char *json);
+void speed_count(caesar_t *aead, const char *timer, const char *op,
+                unsigned long long mlen, unsigned long long adlen,
+                const char *unit, double cnt, const char *json);
+int speed_median(caesar_t *aead, arena_t *ar, unsigned long long mlen,
+                unsigned long long adlen, uint64_t tlim, int reps,
+                stats_t *st);
 int test_speed(caesar_t *aead, int limit);
 int test_throughput(caesar_t *aead, int limit);
 int test_coherence(caesar_t *aead, int limit);
 int test_kat(caesar_t *aead, int limit);
+int test_digest(caesar_t *aead, int limit);
+int kat_digest_run(caesar_t *cand, int ciphers, int limit, int threads);
 int test_xprmnt(caesar_t *aead, int limit);
+int test_scaling(caesar_t *aead, int limit);
+int test_align(caesar_t *aead, int limit);
+int test_inplace(caesar_t *aead, int limit);
+int test_cold(caesar_t *aead, int limit);
+int test_agility(caesar_t *aead, int limit);
+int test_mix(caesar_t *aead, int limit);
+int test_insn(caesar_t *aead, int limit);
+int test_best(caesar_t *aead, int limit);
 
 #endif
@@ -21,14 +21,17 @@ extern "C" {
 #define CRYPTO_decrypt crypto_aead_decrypt
 #endif
 
+// the entry points stay exported under -fvisibility=hidden (mkpgo.sh)
 #ifndef BRUTUS_CRYPTO_AEAD_H
 #define BRUTUS_CRYPTO_AEAD_H
+__attribute__((visibility("default")))
 int crypto_aead_encrypt(unsigned char *c, unsigned long long *clen,
                         const unsigned char *m, unsigned long long mlen,
                         const unsigned char *ad, unsigned long long adlen,
                         const unsigned char *nsec, const unsigned char *npub,
                         const unsigned char *k);
 
+__attribute__((visibility("default")))
 int crypto_aead_decrypt(unsigned char *m, unsigned long long *outputmlen,
                         unsigned char *nsec,
                         const unsigned char *c, unsigned long long clen,
@@ -1,38 +1,140 @@
 #! /bin/bash
 
-#  mkaeadlibs.sh 
+#  mkaeadlibs.sh
 #  21-Sep-14  Markku-Juhani O. Saarinen <mjos@iki.fi>
 
+#  Generates a make graph with one target per implementation and runs it
+#  in parallel. A library is rebuilt only when a file in its directory,
+#  the shared headers, brutus_cc.cfg or this script have changed.
+#  JOBS=N sets the number of parallel compilers (default: all cores).
+
+#  Successful builds are also kept in a cache directory shared between
+#  trees, AEADCACHE (default ~/.cache/brutus, empty to disable), under a
+#  hash of the sources, the shared files, the compiler line and compiler
+#  version. Failures are not cached; they may be transient.
+
 CRYPTO_AEAD=crypto_aead
 AEADLIBS=aeadlibs
+GRAPH=$AEADLIBS/aeadlibs.mk
 BRUTUS_CC=`cat brutus_cc.cfg`
+JOBS=${JOBS:-`nproc`}
+AEADCACHE=${AEADCACHE-$HOME/.cache/brutus}
+
+# shared sources and headers every library is built from, and the flags
+# that are not in brutus_cc.cfg. brutus.h belongs to the harness only.
+LIBSRC=`echo src/aead_params.c inc/brutus_aead.h inc/crypto_*.h`
+LIBFLAGS="-shared -fPIC -Iinc"
+LIBLIBS="-lcrypto"
+
+# make dependencies besides the library's own directory
+COMMON="brutus_cc.cfg mkaeadlibs.sh $LIBSRC"
+
+# cache key part shared by all libraries: the compile line, compiler
+# version and shared sources. not this script; edits to it that change
+# the compile line change the key through LIBFLAGS and LIBLIBS.
+if [ -z "$BRUTUS_CCKEY" ]
+then
+	export BRUTUS_CCKEY=`{ echo "$BRUTUS_CC $LIBFLAGS $LIBLIBS"
+		${BRUTUS_CC%% *} --version 2>&1
+		sha256sum $LIBSRC; } | sha256sum | cut -c1-64`
+fi
 
-# cleanup
-rm -rf $AEADLIBS aeadlibs.txt 
-mkdir $AEADLIBS
+# build a single library; called from the generated graph
+if [ "$1" = "-lib" ]
+then
+	srcdir=$2
+	aead=`echo $srcdir | sed 's@'$CRYPTO_AEAD'/@@g' | tr '/' '-'`
+	echo == $aead ==
+	srcfiles=`ls -1 $srcdir/*.c $srcdir/*.cpp $srcdir/*.cc \
+		$srcdir/*.s $srcdir/*.S  2> /dev/null`
+	rm -f $AEADLIBS/$aead.so
 
+	if [ -n "$AEADCACHE" ]
+	then
+		key=`{ echo $aead $BRUTUS_CCKEY
+			find $srcdir -type f | sort | xargs -r sha256sum
+			} | sha256sum | cut -c1-64`
+		ent=$AEADCACHE/`echo $key | cut -c1-2`/$key
+	fi
+
+	if [ -n "$AEADCACHE" ] && [ -e $ent/$aead.so ]
+	then
+		echo CACHE HIT $key
+		cp $ent/$aead.err $AEADLIBS/$aead.err
+		cp $ent/$aead.so $AEADLIBS/$aead.so
+	else
+		echo COMPILING $srcfiles
+		$BRUTUS_CC $LIBFLAGS -o $AEADLIBS/$aead.so \
+			-I$srcdir -DBRUTUS_NAME='"'$aead'"' \
+			$srcfiles src/aead_params.c $LIBLIBS 2> $AEADLIBS/$aead.err
+
+		# store complete, successful entries only: fill a private
+		# directory first and rename it in place; a concurrent writer
+		# may have won. an entry without a library (left by an older
+		# version of this script) is replaced.
+		if [ -n "$AEADCACHE" ] && [ -e $AEADLIBS/$aead.so ] && \
+			mkdir -p $AEADCACHE/`echo $key | cut -c1-2`
+		then
+			echo CACHE MISS $key
+			[ -e $ent/$aead.so ] || rm -rf $ent
+			tmp=`mktemp -d $ent.XXXXXX` && \
+				cp $AEADLIBS/$aead.err $AEADLIBS/$aead.so $tmp/ && \
+				mv -T $tmp $ent 2> /dev/null
+			rm -rf $tmp
+		fi
+	fi
+
+	if [ -e $AEADLIBS/$aead.so ]
+	then
+		echo -n 'OK.  '
+		du -b $AEADLIBS/$aead.so
+	else
+		echo -n 'FAIL:'
+		wc $AEADLIBS/$aead.err
+	fi
+	echo
+	exit 0
+fi
+
+mkdir -p $AEADLIBS
+
+# the graph is regenerated on every run so that it picks up new, removed
+# and renamed implementations and files. the .err file is the target as
+# it exists also when compilation fails.
 ls -1d $CRYPTO_AEAD/*/* | {
+	echo "# generated by mkaeadlibs.sh"
+	echo
+	echo "COMMON = $COMMON"
+	echo
+	echo -n "all:"
+	libs=""
 	while read srcdir
 	do
 		aead=`echo $srcdir | sed 's@'$CRYPTO_AEAD'/@@g' | tr '/' '-'`
-		echo == $aead == 
-		srcfiles=`ls -1 $srcdir/*.c $srcdir/*.cpp $srcdir/*.cc \
-			$srcdir/*.s $srcdir/*.S  2> /dev/null`
-		echo COMPILING $srcfiles
-		$BRUTUS_CC -shared -fPIC -o $AEADLIBS/$aead.so \
-			-Iinc -I$srcdir -DBRUTUS_NAME='"'$aead'"' \
-			$srcfiles src/aead_params.c -lcrypto 2> $AEADLIBS/$aead.err
-		if [ -e $AEADLIBS/$aead.so ]
-		then
-			echo -n 'OK.  ' 
-			du -b $AEADLIBS/$aead.so 
-		else
-			echo -n 'FAIL:' 
-			wc $AEADLIBS/$aead.err
-		fi
-		echo
-	done } | tee mkaeadlibs.log
+		echo " \\"
+		echo -n "	$AEADLIBS/$aead.err"
+		libs="$libs$AEADLIBS/$aead.err: $srcdir `find $srcdir -type f | \
+			sort | tr '\n' ' '`\$(COMMON)
+	@./mkaeadlibs.sh -lib $srcdir
+
+"
+	done
+	echo
+	echo
+	echo -n "$libs"
+} > $GRAPH
 
-# create the list
-ls -1 $AEADLIBS/*.so > aeadlibs.txt
+make -s -f $GRAPH -j$JOBS --output-sync=target all | tee mkaeadlibs.log
 
+if [ -n "$AEADCACHE" ]
+then
+	echo "CACHE `grep -c '^CACHE HIT' mkaeadlibs.log` hits," \
+		"`grep -c '^CACHE MISS' mkaeadlibs.log` misses ($AEADCACHE)"
+fi
+
+# create the list; only current implementations, not stale or dispatch
+ls -1d $CRYPTO_AEAD/*/* | sed 's@'$CRYPTO_AEAD'/@@g' | tr '/' '-' | \
+	sed 's@^\(.*\)$@'$AEADLIBS'/\1.so@' | while read lib
+	do
+		[ -e $lib ] && echo $lib
+	done > aeadlibs.txt
@@ -0,0 +1,134 @@
+#! /bin/bash
+
+#  mkbundle.sh
+#  18-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+#  Links implementations statically into a single brutus-bundle executable
+#  so that no dlopen() or PLT indirection is involved in the measurements.
+#  Arguments are implementation names or shell patterns as in aeadlibs
+#  ("norx*", "ascon128v11-ref"); default is everything in aeadlibs.txt.
+#  Each implementation becomes one relocatable object in which only the
+#  entry points and parameters are global, renamed to bundle_<id>_*;
+#  src/bundle.c turns the list of objects into a registry.
+
+CRYPTO_AEAD=crypto_aead
+BUNDLE=aeadbundle
+BIN=brutus-bundle
+BRUTUS_CC=`cat brutus_cc.cfg`
+JOBS=${JOBS:-`nproc`}
+OBJS=${OBJS:-`ls src/*.o`}
+LIBS="-ldl -lm -lpthread -lrt -lcrypto -lstdc++"
+SYMS="crypto_aead_encrypt crypto_aead_decrypt brutus_keybytes \
+	brutus_nsecbytes brutus_npubbytes brutus_abytes brutus_nooverlap"
+
+# one implementation object; called in parallel from below
+if [ "$1" = "-obj" ]
+then
+	srcdir=$2
+	aead=$3
+	obj=$BUNDLE/$aead.o
+	err=$BUNDLE/$aead.err
+
+	# up to date ?
+	if [ -e $obj ] && [ -z "`find $srcdir brutus_cc.cfg src/aead_params.c \
+		mkbundle.sh -newer $obj 2> /dev/null`" ]
+	then
+		exit 0
+	fi
+
+	echo == $aead ==
+	id=`echo $aead | tr -c 'A-Za-z0-9\n' '_'`
+	srcfiles=`ls -1 $srcdir/*.c $srcdir/*.cpp $srcdir/*.cc \
+		$srcdir/*.s $srcdir/*.S  2> /dev/null`
+	echo COMPILING $srcfiles
+	tmp=`mktemp -d`
+	rm -f $obj
+	: > $err
+
+	ok=1
+	for src in $srcfiles src/aead_params.c
+	do
+		$BRUTUS_CC -c -o $tmp/`basename $src`.o -Iinc -I$srcdir \
+			-DBRUTUS_NAME='"'$aead'"' $src 2>> $err || ok=0
+	done
+
+	# localize everything else so that implementations can share
+	# symbol names; a trial link catches missing definitions
+	keep=""
+	redef=""
+	for sym in $SYMS
+	do
+		keep="$keep --keep-global-symbol=$sym"
+		redef="$redef --redefine-sym $sym=bundle_${id}_$sym"
+	done
+	echo 'int main() { return 0; }' > $tmp/main.c
+	if [ $ok = 1 ] && ld -r -o $tmp/$aead.o $tmp/*.o 2>> $err && \
+		objcopy $keep $tmp/$aead.o 2>> $err && \
+		objcopy $redef $tmp/$aead.o 2>> $err && \
+		$BRUTUS_CC -no-pie -o $tmp/trial $tmp/main.c $tmp/$aead.o \
+			$LIBS 2>> $err
+	then
+		mv $tmp/$aead.o $obj
+		echo -n 'OK.  '
+		du -b $obj
+	else
+		echo -n 'FAIL:'
+		wc $err
+	fi
+	echo
+	rm -rf $tmp
+	exit 0
+fi
+
+mkdir -p $BUNDLE
+
+if [ $# -eq 0 ]
+then
+	if [ ! -e aeadlibs.txt ]
+	then
+		echo "$0: no aeadlibs.txt; run make libs or give names."
+		exit 1
+	fi
+	set -- `sed -e 's@.*/@@' -e 's@\.so$@@' aeadlibs.txt`
+fi
+
+# implementation directories of the selected names
+ls -1d $CRYPTO_AEAD/*/* | while read srcdir
+do
+	[ -d $srcdir ] || continue
+	aead=`echo $srcdir | sed 's@'$CRYPTO_AEAD'/@@g' | tr '/' '-'`
+	for pat in "$@"
+	do
+		case $aead in
+			$pat)	echo $srcdir $aead
+				break;;
+		esac
+	done
+done > $BUNDLE/selected.txt
+
+xargs -a $BUNDLE/selected.txt -n 2 -P $JOBS ./mkbundle.sh -obj | \
+	tee mkbundle.log
+
+# registry of the objects that were built
+awk '{ print $2 }' $BUNDLE/selected.txt | while read aead
+do
+	if [ -e $BUNDLE/$aead.o ]
+	then
+		id=`echo $aead | tr -c 'A-Za-z0-9\n' '_'`
+		echo "BUNDLE_ENTRY($id, \"$aead\")"
+	fi
+done > $BUNDLE/bundle_entries.h
+
+if [ ! -s $BUNDLE/bundle_entries.h ]
+then
+	echo "$0: nothing to bundle."
+	exit 1
+fi
+
+echo LINKING $BIN `wc -l < $BUNDLE/bundle_entries.h` implementations
+$BRUTUS_CC -Iinc -DBRUTUS_BUNDLE -c -o $BUNDLE/main.o src/main.c && \
+	$BRUTUS_CC -Iinc -I$BUNDLE -c -o $BUNDLE/bundle.o src/bundle.c && \
+	$BRUTUS_CC -no-pie -o $BIN `echo $OBJS | tr ' ' '\n' | \
+		grep -v 'src/main\.o'` $BUNDLE/main.o $BUNDLE/bundle.o \
+		`sed -e 's@.*"\(.*\)".*@'$BUNDLE'/\1.o@' $BUNDLE/bundle_entries.h` \
+		$LIBS
@@ -0,0 +1,128 @@
+#! /bin/bash
+
+#  mkdispatch.sh
+#  17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+#  Build aeadlibs/<cipher>-dispatch.so for each cipher given on the
+#  command line, containing every implementation listed in dispatch.cfg
+#  compiled with its own instruction set flags. The fastest one that the
+#  running CPU supports is picked at load time (see src/dispatch.c).
+#  Without arguments, all ciphers with at least two such implementations.
+
+CRYPTO_AEAD=crypto_aead
+AEADLIBS=aeadlibs
+DISPATCH_CFG=dispatch.cfg
+
+# portable code for the fleet: no native tuning from brutus_cc.cfg
+BRUTUS_CC=`sed -e 's/-march=native//g' -e 's/-mtune=native//g' brutus_cc.cfg`
+BASE_FLAGS="-march=x86-64 -mtune=generic"
+
+mkdir -p $AEADLIBS
+
+if [ $# -eq 0 ]
+then
+	impls=`grep -v '^#' $DISPATCH_CFG | awk '{ print $1 }'`
+	set -- `for cipher in \`ls -1 $CRYPTO_AEAD\`
+	do
+		n=0
+		for impl in $impls
+		do
+			[ -d $CRYPTO_AEAD/$cipher/$impl ] && n=$((n + 1))
+		done
+		[ $n -ge 2 ] && echo $cipher
+	done`
+fi
+
+for cipher in "$@"
+do
+	aead=$cipher-dispatch
+	echo == $aead ==
+	tmp=`mktemp -d`
+	hdr=$tmp/dispatch_variants.h
+	err=$AEADLIBS/$aead.err
+	: > $hdr
+	: > $err
+	apidir=""
+	apidef=""
+
+	while read impl feat flags
+	do
+		srcdir=$CRYPTO_AEAD/$cipher/$impl
+		[ -d $srcdir ] || continue
+
+		# all variants must implement the same parameters
+		def=`grep -h '^#define *CRYPTO_' $srcdir/api.h 2> /dev/null | \
+			tr -s ' \t' ' ' | sort`
+		if [ -z "$apidir" ]
+		then
+			apidir=$srcdir
+			apidef=$def
+		elif [ "$def" != "$apidef" ]
+		then
+			echo "SKIP $impl: api.h differs from `basename $apidir`"
+			continue
+		fi
+
+		id=`echo $impl | tr -c 'A-Za-z0-9\n' '_'`
+		srcfiles=`ls -1 $srcdir/*.c $srcdir/*.cpp $srcdir/*.cc \
+			$srcdir/*.s $srcdir/*.S  2> /dev/null`
+		echo COMPILING $impl $flags
+
+		# one relocatable object per variant; everything but the entry
+		# points is made local so that variants can share symbol names.
+		# a trial link catches non-PIC assembly and missing runtimes.
+		mkdir $tmp/$id
+		ok=1
+		for src in $srcfiles
+		do
+			obj=$tmp/$id/`basename $src`.o
+			$BRUTUS_CC $BASE_FLAGS $flags -fPIC -c -o $obj \
+				-Iinc -I$srcdir $src 2>> $err || ok=0
+		done
+		if [ $ok = 1 ] && ld -r -o $tmp/$id.o $tmp/$id/*.o 2>> $err && \
+			objcopy --keep-global-symbol=crypto_aead_encrypt \
+				--keep-global-symbol=crypto_aead_decrypt \
+				$tmp/$id.o 2>> $err && \
+			objcopy --redefine-sym crypto_aead_encrypt=dispatch_${id}_encrypt \
+				--redefine-sym crypto_aead_decrypt=dispatch_${id}_decrypt \
+				$tmp/$id.o 2>> $err && \
+			$BRUTUS_CC -shared -Wl,--no-undefined -o $tmp/$id.so \
+				-Iinc -I$srcdir $tmp/$id.o src/aead_params.c \
+				-lcrypto 2>> $err
+		then
+			cond=1
+			if [ "$feat" != "-" ]
+			then
+				cond=`echo $feat | sed -e 's/^/__builtin_cpu_supports("/' \
+					-e 's/,/") \&\& __builtin_cpu_supports("/g' -e 's/$/")/'`
+			fi
+			echo "DISPATCH_VARIANT($id, \"$impl\", $cond)" >> $hdr
+		else
+			echo "FAIL $impl"
+			rm -f $tmp/$id.o
+		fi
+		rm -f $tmp/$id.so
+	done < <(grep -v '^#' $DISPATCH_CFG | grep -v '^ *$')
+
+	if ! grep -q ', 1)$' $hdr
+	then
+		echo "WARNING no variant without CPU requirements"
+	fi
+	if [ -s $hdr ]
+	then
+		echo VARIANTS `sed 's/DISPATCH_VARIANT([^,]*, "\([^"]*\)".*/\1/' $hdr`
+		$BRUTUS_CC $BASE_FLAGS -shared -fPIC -o $AEADLIBS/$aead.so \
+			-Iinc -I$apidir -I$tmp -DBRUTUS_NAME='"'$aead'"' \
+			src/dispatch.c src/aead_params.c $tmp/*.o -lcrypto 2>> $err
+	fi
+	if [ -e $AEADLIBS/$aead.so ]
+	then
+		echo -n 'OK.  '
+		du -b $AEADLIBS/$aead.so
+	else
+		echo -n 'FAIL:'
+		wc $err
+	fi
+	echo
+	rm -rf $tmp
+done
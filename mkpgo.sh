@@ -0,0 +1,142 @@
+#! /bin/bash
+
+#  mkpgo.sh
+#  18-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+#  Profile-guided, link-time optimized builds of the implementations.
+#  Each one is built instrumented, trained by brutus with the throughput
+#  and packet mix workloads, and rebuilt from the profile with -flto,
+#  -fvisibility=hidden and -fno-plt into aeadpgo/<name>.so. The speed is
+#  then compared against the plain build in aeadlibs. Arguments are names
+#  or patterns as for mkbundle.sh; default is everything in aeadlibs.txt.
+#  Needs gcc (gcov profiles) and ./brutus.
+
+CRYPTO_AEAD=crypto_aead
+AEADLIBS=aeadlibs
+AEADPGO=aeadpgo
+BRUTUS_CC=`cat brutus_cc.cfg`
+JOBS=${JOBS:-`nproc`}
+PGO_GEN="-fprofile-generate"
+PGO_USE="-fprofile-use -Wno-missing-profile -flto -fvisibility=hidden \
+	-fno-plt"
+TRAIN="-q -f1 -Mimix"
+MEASURE="-q -f1"
+
+# compile srcdir into a library with extra flags: pgo_build flags lib
+pgo_build()
+{
+	ok=1
+	for src in $srcfiles
+	do
+		case $src in
+			*.s|*.S)	inc="";;
+			*)		inc="-include brutus_aead.h";;
+		esac
+		$BRUTUS_CC $1 -fPIC $inc -c -o $dir/`basename $src`.o \
+			-Iinc -I$srcdir -DBRUTUS_NAME='"'$aead'"' $src 2>> $err || ok=0
+	done
+	[ $ok = 1 ] && $BRUTUS_CC $1 -shared -o $2 $dir/*.o -lcrypto 2>> $err
+}
+
+# one implementation; called in parallel from below
+if [ "$1" = "-lib" ]
+then
+	srcdir=$2
+	aead=$3
+	dir=$AEADPGO/$aead.d
+	err=$AEADPGO/$aead.err
+	echo == $aead ==
+	srcfiles=`ls -1 $srcdir/*.c $srcdir/*.cpp $srcdir/*.cc \
+		$srcdir/*.s $srcdir/*.S  2> /dev/null`
+	srcfiles="$srcfiles src/aead_params.c"
+	rm -rf $dir $AEADPGO/$aead.so
+	mkdir -p $dir
+	: > $err
+
+	# the profile (.gcda) is written next to each object, so the same
+	# object paths must be used in both builds
+	echo TRAINING $aead
+	if pgo_build "$PGO_GEN" $dir/gen.so
+	then
+		./brutus $TRAIN $dir/gen.so > /dev/null 2>> $err
+		if [ -z "`ls $dir/*.gcda 2> /dev/null`" ]
+		then
+			echo "WARNING no profile"
+		fi
+		rm -f $dir/*.o $dir/gen.so
+		pgo_build "$PGO_USE" $AEADPGO/$aead.so
+	fi
+
+	if [ -e $AEADPGO/$aead.so ]
+	then
+		echo -n 'OK.  '
+		du -b $AEADPGO/$aead.so
+	else
+		echo -n 'FAIL:'
+		wc $err
+	fi
+	echo
+	exit 0
+fi
+
+mkdir -p $AEADPGO
+
+if [ $# -eq 0 ]
+then
+	if [ ! -e aeadlibs.txt ]
+	then
+		echo "$0: no aeadlibs.txt; run make libs or give names."
+		exit 1
+	fi
+	set -- `sed -e 's@.*/@@' -e 's@\.so$@@' aeadlibs.txt`
+fi
+
+# implementation directories of the selected names
+ls -1d $CRYPTO_AEAD/*/* | while read srcdir
+do
+	[ -d $srcdir ] || continue
+	aead=`echo $srcdir | sed 's@'$CRYPTO_AEAD'/@@g' | tr '/' '-'`
+	for pat in "$@"
+	do
+		case $aead in
+			$pat)	echo $srcdir $aead
+				break;;
+		esac
+	done
+done > $AEADPGO/selected.txt
+
+xargs -a $AEADPGO/selected.txt -n 2 -P $JOBS ./mkpgo.sh -lib | \
+	tee mkpgo.log
+
+# gain per candidate, measured one at a time: text output lines are
+# "[name] N kB/s  encrypt(..)" and "[name] N kB/s  decrypt(..)"
+pgo_speed()
+{
+	./brutus $MEASURE $1 2> /dev/null | awk '
+		/ encrypt\(/ { enc = $2 }
+		/ decrypt\(/ { dec = $2 }
+		END { print enc + 0, dec + 0 }'
+}
+
+printf "# name\tbase_enc\tpgo_enc\tgain_enc\tbase_dec\tpgo_dec\tgain_dec\n" \
+	> $AEADPGO/gain.txt
+awk '{ print $2 }' $AEADPGO/selected.txt | while read aead
+do
+	base=$AEADLIBS/$aead.so
+	pgo=$AEADPGO/$aead.so
+	[ -e $pgo ] || continue
+	if [ ! -e $base ]
+	then
+		echo "[$aead] no baseline $base"
+		continue
+	fi
+	echo $aead `pgo_speed $base` `pgo_speed $pgo` | awk '
+		function gain(a, b) { return a > 0 ? 100.0 * (b / a - 1.0) : 0 }
+		{
+			printf("[%s] encrypt %.2f -> %.2f kB/s %+.1f%%  " \
+				"decrypt %.2f -> %.2f kB/s %+.1f%%\n",
+				$1, $2, $4, gain($2, $4), $3, $5, gain($3, $5)) > "/dev/stderr"
+			printf("%s\t%.2f\t%.2f\t%.1f\t%.2f\t%.2f\t%.1f\n",
+				$1, $2, $4, gain($2, $4), $3, $5, gain($3, $5))
+		}' >> $AEADPGO/gain.txt
+done 2>&1
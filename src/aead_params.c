@@ -48,29 +48,31 @@ void crypto_core_aes256decrypt(void *out, void *in, void *k, int flag)
     AES_decrypt(in, out, &ek);
 }
 
-// make them available as symbols
+// make them available as symbols, also under -fvisibility=hidden
+
+#define BRUTUS_EXPORT __attribute__((visibility("default")))
 
 #ifdef BRUTUS_NAME
-const char brutus_name[] = BRUTUS_NAME;
+BRUTUS_EXPORT const char brutus_name[] = BRUTUS_NAME;
 #endif
 
 #ifdef CRYPTO_KEYBYTES
-const int brutus_keybytes = (CRYPTO_KEYBYTES);
+BRUTUS_EXPORT const int brutus_keybytes = (CRYPTO_KEYBYTES);
 #endif
 
 #ifdef CRYPTO_NSECBYTES
-const int brutus_nsecbytes = (CRYPTO_NSECBYTES);
+BRUTUS_EXPORT const int brutus_nsecbytes = (CRYPTO_NSECBYTES);
 #endif
 
 #ifdef CRYPTO_NPUBBYTES
-const int brutus_npubbytes = (CRYPTO_NPUBBYTES);
+BRUTUS_EXPORT const int brutus_npubbytes = (CRYPTO_NPUBBYTES);
 #endif
 
 #ifdef CRYPTO_ABYTES
-const int brutus_abytes = (CRYPTO_ABYTES);
+BRUTUS_EXPORT const int brutus_abytes = (CRYPTO_ABYTES);
 #endif
 
 #ifdef CRYPTO_NOOVERLAP
-const int brutus_nooverlap = (CRYPTO_NOOVERLAP);
+BRUTUS_EXPORT const int brutus_nooverlap = (CRYPTO_NOOVERLAP);
 #endif
 
@@ -0,0 +1,240 @@
+// agility.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Key agility: switch key (and nonce) every K messages and separate
+// the fixed per-call and per-key costs from the per-byte cost by fitting
+// straight lines over message length and (at the shortest message)
+// over 1/K. Note that the crypto_aead API runs the key schedule on
+// every call; per-key cost only shows schedules cached across calls
+// and cache misses on fresh key material.
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "brutus.h"
+
+// number of distinct keys rotated through, key change intervals
+#define AGILITY_KEYS    256
+#define AGILITY_KS      4
+
+static const int agility_k[AGILITY_KS] = { 1, 8, 64, 0 };   // 0 = never
+
+// key schedule period: a multiple of every K times the number of keys
+#define AGILITY_SCHED   (64 * AGILITY_KEYS)
+
+// key (followed by its nonce) used by each call of a period, so that
+// the timed loop does the same table walk for every K
+
+static void agility_sched(caesar_t *aead, arena_t *ar, int k, uint8_t **sched)
+{
+    int i;
+    size_t sz;
+
+    sz = aead->keybytes + aead->npubbytes;
+    for (i = 0; i < AGILITY_SCHED; i++)
+        sched[i] = ar->ad + (k > 0 ? (i / k % AGILITY_KEYS) * sz : 0);
+}
+
+// calls and ticks for a key schedule
+
+static int agility_run(caesar_t *aead, arena_t *ar, uint8_t **sched,
+                    unsigned long long mlen, uint64_t tlim,
+                    unsigned long long *calls, uint64_t *ticks)
+{
+    int ret, pos;
+    unsigned long long i, sta, stb, clen;
+    uint64_t stim, etim;
+    uint8_t *key;
+    size_t ks;
+
+    ks = aead->keybytes;
+
+    stim = timer_start();
+    *calls = 0;
+    pos = 0;
+    sta = 1;
+    stb = 1;
+    do {
+        for (i = 0; i < sta; i++) {
+            key = sched[pos];
+            if (++pos >= AGILITY_SCHED)
+                pos = 0;
+            clen = 0;
+            ret = aead->encrypt(ar->ct, &clen, ar->pt, mlen, ar->pt, 0,
+                ar->nsec, key + ks, key);
+            if (ret != 0 || clen <= 0) {
+                fprintf(stderr, "!ERROR\t%s encrypt(%llu)=%d\n",
+                    aead->name, mlen, ret);
+                return -1;
+            }
+        }
+        *calls += sta;
+        sta += stb;
+        stb = sta - stb;
+
+        etim = timer_read() - stim;
+    } while (etim < tlim);
+    *ticks = timer_stop() - stim;
+
+    return 0;
+}
+
+// result name for the j'th key change interval
+
+static void agility_op(char *op, size_t sz, int j)
+{
+    if (agility_k[j] > 0)
+        snprintf(op, sz, "agility-k%d", agility_k[j]);
+    else
+        snprintf(op, sz, "agility-kinf");
+}
+
+// structured rows, once the fits are known
+
+static void agility_rows(caesar_t *aead, const lenlist_t *ml, int j,
+                        const unsigned long long *calls,
+                        const uint64_t *ticks, double fixed, double perb,
+                        double perk, const char *unit)
+{
+    int i;
+    char op[32], json[160];
+
+    agility_op(op, sizeof(op), j);
+    snprintf(json, sizeof(json), ",\"k\":%d,\"fit_unit\":\"%s\","
+        "\"fixed\":%.1f,\"per_byte\":%.3f,\"per_key\":%.1f",
+        agility_k[j], unit, fixed, perb, perk);
+    for (i = 0; i < ml->n; i++) {
+        speed_row(aead, timer_name(), op, ml->len[i], 0, calls[i],
+            timer_sec(ticks[i]), NULL, json);
+    }
+}
+
+int test_agility(caesar_t *aead, int limit)
+{
+    int ret, i, j, nl, imin;
+    unsigned long long deflen[5] = { 16, 64, 256, 1024, 4096 };
+    unsigned long long maxlen, *calls;
+    uint64_t tlim, *ticks;
+    uint8_t **sched;
+    double *x, *y, fixed[AGILITY_KS], perb[AGILITY_KS], invk[AGILITY_KS],
+        ymin[AGILITY_KS];
+    double f, a, b, sec, ns;
+    const char *unit;
+    char op[32];
+    lenlist_t ml;
+    arena_t ar;
+
+    ml = brutus_mlens;
+    if (ml.n == 0) {
+        ml.n = 5;
+        ml.len = deflen;
+    }
+    nl = ml.n;
+    maxlen = 0;
+    imin = 0;
+    for (i = 0; i < nl; i++) {
+        if (ml.len[i] > maxlen)
+            maxlen = ml.len[i];
+        if (ml.len[i] < ml.len[imin])
+            imin = i;
+    }
+
+    if (brutus_verbose) {
+        printf("[%s] Key Agility (limit=%d sec, keys=%d)  "
+            "key=%d  nsec=%d  npub=%d  a=%d\n",
+            aead->name, limit, AGILITY_KEYS, aead->keybytes,
+            aead->nsecbytes, aead->npubbytes, aead->abytes);
+    }
+
+    // ad region holds the key and nonce table
+    if (arena_alloc(&ar, aead, maxlen,
+        AGILITY_KEYS * (aead->keybytes + aead->npubbytes)) != 0)
+        return -1;
+    detseq_fill(ar.pt, maxlen);
+    detseq_fill(ar.ad, AGILITY_KEYS * (aead->keybytes + aead->npubbytes));
+    detseq_fill(ar.key, aead->keybytes);
+    detseq_fill(ar.nsec, aead->nsecbytes);
+    detseq_fill(ar.npub, aead->npubbytes);
+
+    x = calloc(nl, sizeof(double));
+    y = calloc(nl, sizeof(double));
+    calls = calloc(AGILITY_KS * nl, sizeof(unsigned long long));
+    ticks = calloc(AGILITY_KS * nl, sizeof(uint64_t));
+    sched = calloc(AGILITY_SCHED, sizeof(uint8_t *));
+    if (x == NULL || y == NULL || calls == NULL || ticks == NULL ||
+        sched == NULL) {
+        perror("test_agility()");
+        ret = -1;
+        goto done;
+    }
+
+    if (timer_cycles(1.0) > 0.0) {
+        f = timer_cycles(1.0);
+        unit = "c";
+    } else {
+        f = 1E9 * timer_sec(1.0);
+        unit = "ns";
+    }
+    tlim = timer_ticks(limit) / (AGILITY_KS * nl);
+
+    // per K: cost over message length -> fixed + per-byte
+    for (j = 0; j < AGILITY_KS; j++) {
+        agility_sched(aead, &ar, agility_k[j], sched);
+        if (brutus_format == FORMAT_TEXT) {
+            if (agility_k[j] > 0)
+                printf("[%s] K=%-4d", aead->name, agility_k[j]);
+            else
+                printf("[%s] K=inf ", aead->name);
+        }
+        agility_op(op, sizeof(op), j);
+        for (i = 0; i < nl; i++) {
+            if ((ret = agility_run(aead, &ar, sched, ml.len[i], tlim,
+                &calls[j * nl + i], &ticks[j * nl + i])) != 0)
+                goto done;
+            y[i] = f * ((double) ticks[j * nl + i]) /
+                ((double) calls[j * nl + i]);
+            x[i] = (double) ml.len[i];
+            if (brutus_format == FORMAT_TEXT)
+                printf(" %llu:%.0f", ml.len[i], y[i]);
+            sec = timer_sec(ticks[j * nl + i]);
+            ns = 1E9 * sec / ((double) calls[j * nl + i]);
+            results_record(aead, op, ml.len[i], 0, 0, ns, ns, ns,
+                ((double) (ml.len[i] * calls[j * nl + i])) / sec / 1000.0);
+        }
+        stats_linfit(x, y, nl, &fixed[j], &perb[j]);
+        invk[j] = agility_k[j] > 0 ? 1.0 / agility_k[j] : 0.0;
+        ymin[j] = y[imin];
+        if (brutus_format == FORMAT_TEXT) {
+            printf("  %s/call  fixed=%.0f %s  %.2f %s/B\n",
+                unit, fixed[j], unit, perb[j], unit);
+            fflush(stdout);
+        }
+    }
+
+    // shortest message cost over 1/K -> per-key overhead
+    stats_linfit(invk, ymin, AGILITY_KS, &a, &b);
+    if (brutus_format == FORMAT_TEXT) {
+        printf("[%s] per-call fixed=%.0f %s  per-key=%.0f %s  "
+            "per-byte=%.2f %s/B\n", aead->name, fixed[AGILITY_KS - 1], unit,
+            b, unit, perb[AGILITY_KS - 1], unit);
+    } else {
+        for (j = 0; j < AGILITY_KS; j++) {
+            agility_rows(aead, &ml, j, &calls[j * nl], &ticks[j * nl],
+                fixed[j], perb[j], b, unit);
+        }
+    }
+    fflush(stdout);
+    ret = 0;
+
+done:
+    free(x);
+    free(y);
+    free(calls);
+    free(ticks);
+    free(sched);
+    arena_free(&ar);
+
+    return ret;
+}
@@ -0,0 +1,123 @@
+// arena.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Test buffers sized from candidate parameters. One mapping per arena,
+// every buffer starts on a page boundary; optionally hugepage backed.
+// With in-process tests (-X) the buffers are separated by guard pages and
+// each one ends exactly at its trailing guard, so that even a one-byte
+// overrun faults instead of corrupting a neighbouring buffer. Guard pages
+// need small pages, so explicit hugepages give way to transparent ones.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "brutus.h"
+
+int brutus_hugepages = 0;
+
+// round up to a multiple of a (power of two)
+
+static size_t arena_round(size_t x, size_t a)
+{
+    return (x + a - 1) & ~(a - 1);
+}
+
+// allocate buffers for messages up to mlen and associated data up to adlen
+
+int arena_alloc(arena_t *ar, caesar_t *aead, size_t mlen, size_t adlen)
+{
+    size_t pg, guard, len, sz[ARENA_BUFS], tot;
+    uint8_t *p, **buf[ARENA_BUFS];
+    int i;
+
+    memset(ar, 0, sizeof(arena_t));
+    ar->mlen = mlen;
+    ar->adlen = adlen;
+
+    pg = sysconf(_SC_PAGESIZE);
+    if (pg < ARENA_ALIGN)
+        pg = ARENA_ALIGN;
+
+    // +1 so that zero-length buffers still have a distinct address
+    buf[0] = &ar->key;
+    sz[0] = aead->keybytes + 1;
+    buf[1] = &ar->nsec;
+    sz[1] = aead->nsecbytes + 1;
+    buf[2] = &ar->osec;
+    sz[2] = aead->nsecbytes + 1;
+    buf[3] = &ar->npub;
+    sz[3] = aead->npubbytes + 1;
+    buf[4] = &ar->pt;
+    sz[4] = mlen + 1;
+    buf[5] = &ar->xt;
+    sz[5] = mlen + 1;
+    buf[6] = &ar->ad;
+    sz[6] = adlen + 1;
+    buf[7] = &ar->ct;
+    sz[7] = mlen + aead->abytes + 1;
+
+    guard = brutus_inproc ? sysconf(_SC_PAGESIZE) : 0;
+    tot = guard;
+    for (i = 0; i < ARENA_BUFS; i++)
+        tot += arena_round(sz[i], pg) + guard;
+
+    // explicit hugepages first, then transparent ones, then normal pages
+    p = MAP_FAILED;
+    if (brutus_hugepages) {
+        ar->size = arena_round(tot, ARENA_HUGE);
+#ifdef MAP_HUGETLB
+        if (guard == 0)
+            p = mmap(NULL, ar->size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (p == MAP_FAILED) {
+            p = mmap(NULL, ar->size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (p != MAP_FAILED)
+                madvise(p, ar->size, MADV_HUGEPAGE);
+#endif
+        }
+    } else {
+        ar->size = tot;
+        p = mmap(NULL, ar->size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (p == MAP_FAILED) {
+        perror("arena_alloc()");
+        ar->size = 0;
+        return -1;
+    }
+    ar->base = p;
+
+    for (i = 0; i < ARENA_BUFS; i++) {
+        if (guard > 0 && mprotect(p, guard, PROT_NONE) != 0)
+            goto fail;
+        p += guard;
+        len = arena_round(sz[i], pg);
+        // guarded: drop the +1 slack and end-align against the guard
+        *buf[i] = guard > 0 ? p + len - (sz[i] - 1) : p;
+        p += len;
+    }
+    if (guard > 0 && mprotect(p, guard, PROT_NONE) != 0)
+        goto fail;
+
+    return 0;
+
+fail:
+    perror("arena_alloc(): guard page");
+    arena_free(ar);
+    return -1;
+}
+
+// release the buffers
+
+void arena_free(arena_t *ar)
+{
+    if (ar->base != NULL)
+        munmap(ar->base, ar->size);
+    memset(ar, 0, sizeof(arena_t));
+}
@@ -0,0 +1,225 @@
+// best.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Best implementation per cipher. Candidates are grouped by the cipher
+// part of their name; all variants of a cipher must produce the same
+// output, and the ones that do are benchmarked and ranked. The winners
+// are written to a manifest that can be fed back to brutus.
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "brutus.h"
+
+// output check covers mlen 0..BEST_VLEN, speed is the median of
+// BEST_REPS runs; the manifest goes to BEST_MANIFEST unless set by -A
+#define BEST_VLEN       128
+#define BEST_REPS       5
+#define BEST_SEED       0x5EED
+#define BEST_MANIFEST   "aeadbest.txt"
+
+typedef struct {
+    uint64_t digest;                    // hash of all test vectors
+    int ok;                             // ran to completion
+    double kbps;                        // median throughput
+} best_res_t;
+
+const char *brutus_best = BEST_MANIFEST;
+
+// result of the candidate under test, in memory shared with the child
+static best_res_t *best_cur = NULL;
+
+// test vectors and throughput of one candidate
+
+static int best_measure(caesar_t *aead, int limit, best_res_t *res)
+{
+    int ret, i;
+    unsigned long long mlen, adlen, clen, t;
+    uint64_t h;
+    stats_t st;
+    arena_t ar;
+
+    mlen = brutus_mlens.n > 0 ? brutus_mlens.len[0] : 1536;
+    adlen = brutus_adlens.n > 0 ? brutus_adlens.len[0] : 0;
+
+    t = BEST_VLEN > mlen ? BEST_VLEN : mlen;
+    if (arena_alloc(&ar, aead, t + aead->abytes, t) != 0)
+        return -1;
+
+    // same inputs for every candidate; the harness restores detseq
+    detseq_seed(BEST_SEED);
+    detseq_fill(ar.key, aead->keybytes);
+    detseq_fill(ar.nsec, aead->nsecbytes);
+    detseq_fill(ar.npub, aead->npubbytes);
+    detseq_fill(ar.pt, t);
+    detseq_fill(ar.ad, t);
+
+    h = HASH_FNV_INIT;
+    for (i = 0; i <= BEST_VLEN; i++) {
+        clen = 0;
+        ret = aead->encrypt(ar.ct, &clen, ar.pt, i, ar.ad, (i * 7) % 33,
+            ar.nsec, ar.npub, ar.key);
+        if (ret != 0 || clen < (unsigned long long) i ||
+            aead->decrypt(ar.xt, &t, ar.osec, ar.ct, clen, ar.ad,
+            (i * 7) % 33, ar.npub, ar.key) != 0 ||
+            t != (unsigned long long) i || memcmp(ar.xt, ar.pt, i) != 0) {
+            fprintf(stderr, "!FAIL\t%s encrypt / decrypt(mlen=%d)\n",
+                aead->name, i);
+            ret = -1;
+            goto done;
+        }
+        h = hash_fnv(h, (uint8_t *) &clen, sizeof(clen));
+        h = hash_fnv(h, ar.ct, clen);
+    }
+    res->digest = h;
+
+    // a candidate that fails while timed is not ranked
+    if ((ret = speed_median(aead, &ar, mlen, adlen, timer_ticks(limit),
+        BEST_REPS, &st)) != 0)
+        goto done;
+    res->kbps = ((double) (mlen + adlen)) / timer_sec(st.med) / 1000.0;
+    res->ok = 1;
+    ret = 0;
+
+done:
+    arena_free(&ar);
+
+    return ret;
+}
+
+// run by test_harness() for the limit (-T) and time share (-t)
+
+int test_best(caesar_t *aead, int limit)
+{
+    return best_measure(aead, limit, best_cur);
+}
+
+// variants with the same parameters and output as the reference
+
+static int best_same(caesar_t *a, best_res_t *ra, caesar_t *b, best_res_t *rb)
+{
+    return ra->ok && rb->ok && ra->digest == rb->digest &&
+        a->keybytes == b->keybytes && a->nsecbytes == b->nsecbytes &&
+        a->npubbytes == b->npubbytes && a->abytes == b->abytes;
+}
+
+int best_run(caesar_t *cand, int ciphers, int limit)
+{
+    int i, j, k, n, pfx, ref, *grp, *done;
+    best_res_t *res;
+    FILE *f;
+
+    res = mmap(NULL, ciphers * sizeof(best_res_t), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (res == MAP_FAILED) {
+        perror("best_run()");
+        return -1;
+    }
+    grp = calloc(ciphers, sizeof(int));
+    done = calloc(ciphers, sizeof(int));
+    if (grp == NULL || done == NULL) {
+        perror("best_run()");
+        munmap(res, ciphers * sizeof(best_res_t));
+        return -1;
+    }
+
+    // measure every candidate, strictly serialized
+    for (i = 0; i < ciphers; i++) {
+        harness_budget(harness_unit());
+        harness_spend(1.0);
+        if (brutus_verbose) {
+            printf("[%s] Best Implementation (limit=%d sec)  "
+                "key=%d  nsec=%d  npub=%d  a=%d\n",
+                cand[i].name, limit, cand[i].keybytes, cand[i].nsecbytes,
+                cand[i].npubbytes, cand[i].abytes);
+        }
+        fflush(stdout);
+        best_cur = &res[i];
+        test_harness(test_best, &cand[i], limit);
+        if (!res[i].ok)
+            fprintf(stderr, "!FAIL\t%s excluded from ranking\n",
+                cand[i].name);
+    }
+    harness_budget(0.0);
+
+    if ((f = fopen(brutus_best, "w")) == NULL)
+        perror(brutus_best);
+    else
+        fprintf(f, "# cipher\timpl\tfile\tkBps\tvariants\n");
+
+    for (i = 0; i < ciphers; i++) {
+        if (done[i])
+            continue;
+
+        // group by cipher prefix
+        pfx = name_prefix(cand[i].name);
+        n = 0;
+        ref = -1;
+        for (j = i; j < ciphers; j++) {
+            if (done[j] || name_prefix(cand[j].name) != pfx ||
+                strncmp(cand[i].name, cand[j].name, pfx) != 0)
+                continue;
+            done[j] = 1;
+            grp[n++] = j;
+            if (res[j].ok && (ref < 0 ||
+                strcmp(&cand[j].name[pfx], "-ref") == 0))
+                ref = j;
+        }
+
+        // none completed: nothing to compare against or rank
+        if (ref < 0)
+            continue;
+
+        // drop variants that disagree with the reference
+        k = 0;
+        for (j = 0; j < n; j++) {
+            if (best_same(&cand[ref], &res[ref],
+                &cand[grp[j]], &res[grp[j]])) {
+                grp[k++] = grp[j];
+            } else if (res[grp[j]].ok) {
+                fprintf(stderr, "!MISMATCH\t%s output differs from %s\n",
+                    cand[grp[j]].name, cand[ref].name);
+            }
+        }
+        n = k;
+        if (n == 0)
+            continue;
+
+        // insertion sort by throughput, fastest first
+        for (j = 1; j < n; j++) {
+            k = grp[j];
+            for (ref = j; ref > 0 && res[grp[ref - 1]].kbps < res[k].kbps;
+                ref--)
+                grp[ref] = grp[ref - 1];
+            grp[ref] = k;
+        }
+
+        for (j = 0; j < n; j++) {
+            k = grp[j];
+            printf("[%.*s] %2d. %-32s %12.2f kB/s  %6.1f%%\n", pfx,
+                cand[k].name, j + 1, cand[k].name, res[k].kbps,
+                100.0 * res[k].kbps / res[grp[0]].kbps);
+        }
+        if (f != NULL) {
+            k = grp[0];
+            fprintf(f, "%.*s\t%s\t%s\t%.2f\t%d\n", pfx, cand[k].name,
+                cand[k].name[pfx] == '-' ? &cand[k].name[pfx + 1] : "",
+                cand[k].file != NULL ? cand[k].file : "", res[k].kbps, n);
+        }
+        fflush(stdout);
+    }
+
+    if (f != NULL) {
+        fclose(f);
+        if (brutus_verbose)
+            printf("\tselection written to %s\n", brutus_best);
+    }
+    free(grp);
+    free(done);
+    munmap(res, ciphers * sizeof(best_res_t));
+
+    return 0;
+}
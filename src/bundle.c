@@ -0,0 +1,114 @@
+// bundle.c
+// 18-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Static registry of the implementations linked into brutus-bundle by
+// mkbundle.sh. The generated bundle_entries.h has one line per object:
+//
+//     BUNDLE_ENTRY(id, "name")
+//
+// where the object's crypto_aead_* and brutus_* symbols have been renamed
+// to bundle_<id>_crypto_aead_* and bundle_<id>_brutus_*. Parameters that
+// an implementation does not define are weak references and read as 0.
+
+#include <stdio.h>
+#include <string.h>
+#include <fnmatch.h>
+
+#include "brutus.h"
+
+#define BUNDLE_ENTRY(id, name) \
+    int bundle_ ## id ## _crypto_aead_encrypt(unsigned char *, \
+        unsigned long long *, const unsigned char *, unsigned long long, \
+        const unsigned char *, unsigned long long, const unsigned char *, \
+        const unsigned char *, const unsigned char *); \
+    int bundle_ ## id ## _crypto_aead_decrypt(unsigned char *, \
+        unsigned long long *, unsigned char *, const unsigned char *, \
+        unsigned long long, const unsigned char *, unsigned long long, \
+        const unsigned char *, const unsigned char *); \
+    extern const int bundle_ ## id ## _brutus_keybytes \
+        __attribute__((weak)); \
+    extern const int bundle_ ## id ## _brutus_nsecbytes \
+        __attribute__((weak)); \
+    extern const int bundle_ ## id ## _brutus_npubbytes \
+        __attribute__((weak)); \
+    extern const int bundle_ ## id ## _brutus_abytes \
+        __attribute__((weak)); \
+    extern const int bundle_ ## id ## _brutus_nooverlap \
+        __attribute__((weak));
+#include "bundle_entries.h"
+#undef BUNDLE_ENTRY
+
+typedef struct {
+    const char *name;
+    const int *keybytes, *nsecbytes, *npubbytes, *abytes, *nooverlap;
+    int (*encrypt)(unsigned char *c, unsigned long long *clen,
+        const unsigned char *m, unsigned long long mlen,
+        const unsigned char *ad, unsigned long long adlen,
+        const unsigned char *nsec, const unsigned char *npub,
+        const unsigned char *k);
+    int (*decrypt)(unsigned char *m, unsigned long long *outputmlen,
+        unsigned char *nsec, const unsigned char *c, unsigned long long clen,
+        const unsigned char *ad, unsigned long long adlen,
+        const unsigned char *npub, const unsigned char *k);
+} bundle_t;
+
+static const bundle_t bundle_table[] = {
+#define BUNDLE_ENTRY(id, name) \
+    { name, &bundle_ ## id ## _brutus_keybytes, \
+        &bundle_ ## id ## _brutus_nsecbytes, \
+        &bundle_ ## id ## _brutus_npubbytes, \
+        &bundle_ ## id ## _brutus_abytes, \
+        &bundle_ ## id ## _brutus_nooverlap, \
+        bundle_ ## id ## _crypto_aead_encrypt, \
+        bundle_ ## id ## _crypto_aead_decrypt },
+#include "bundle_entries.h"
+#undef BUNDLE_ENTRY
+};
+
+#define BUNDLE_SIZE ((int) (sizeof(bundle_table) / sizeof(bundle_table[0])))
+
+int bundle_size()
+{
+    return BUNDLE_SIZE;
+}
+
+// fill in the entries matching a name or wildcard pattern. library paths
+// such as aeadlibs/foo-ref.so are accepted for foo-ref. returns the count.
+
+int bundle_find(caesar_t *cand, const char *pattern)
+{
+    int i, n;
+    const char *p;
+    char buf[256];
+
+    if ((p = strrchr(pattern, '/')) != NULL)
+        pattern = p + 1;
+    snprintf(buf, sizeof(buf), "%s", pattern);
+    n = strlen(buf);
+    if (n > 3 && strcmp(&buf[n - 3], ".so") == 0)
+        buf[n - 3] = 0;
+
+    n = 0;
+    for (i = 0; i < BUNDLE_SIZE; i++) {
+        if (fnmatch(buf, bundle_table[i].name, 0) != 0)
+            continue;
+        memset(&cand[n], 0, sizeof(caesar_t));
+        cand[n].name = (char *) bundle_table[i].name;
+        cand[n].file = (char *) bundle_table[i].name;
+        if (bundle_table[i].keybytes != NULL)
+            cand[n].keybytes = *bundle_table[i].keybytes;
+        if (bundle_table[i].nsecbytes != NULL)
+            cand[n].nsecbytes = *bundle_table[i].nsecbytes;
+        if (bundle_table[i].npubbytes != NULL)
+            cand[n].npubbytes = *bundle_table[i].npubbytes;
+        if (bundle_table[i].abytes != NULL)
+            cand[n].abytes = *bundle_table[i].abytes;
+        if (bundle_table[i].nooverlap != NULL)
+            cand[n].nooverlap = *bundle_table[i].nooverlap;
+        cand[n].encrypt = bundle_table[i].encrypt;
+        cand[n].decrypt = bundle_table[i].decrypt;
+        n++;
+    }
+
+    return n;
+}
@@ -10,25 +10,34 @@
 
 #include "brutus.h"
 
+// maximum message and associated data length
+#ifndef COHERENCE_LEN
+#define COHERENCE_LEN 0x100
+#endif
+
 int test_coherence(caesar_t *aead, int limit)
 {
-    int ret, forge, iter, off, bit;
+    int ret, res, forge, iter, off, bit;
     int forge_ok, forge_try;
     unsigned long long mlen, clen, adlen, t;
     time_t tim;
     const char *fcase[4] = { "key", "npub", "ad", "ct" };
+    uint8_t *key, *nsec, *osec, *npub, *pt, *ad, *xt, *ct;
+    arena_t ar;
 
-    uint8_t key[80], nsec[64], osec[64], npub[64];
-
-    // that 524304 ABYTES factor comes from Trivia. Don't ask.
-    uint8_t pt[0x100], ad[0x100], xt[0x100], ct[0x100 + 524304];
-
-    if (aead->name == NULL || aead->abytes + sizeof(pt) > sizeof(ct) ||
-        aead->keybytes > sizeof(key) || aead->nsecbytes > sizeof(nsec) ||
-        aead->nsecbytes > sizeof(osec) || aead->npubbytes > sizeof(npub)) {
+    if (aead->name == NULL || aead->keybytes <= 0 ||
+        arena_alloc(&ar, aead, COHERENCE_LEN, COHERENCE_LEN) != 0) {
         fprintf(stderr, "test_coherence(): invalid parameters\n");
         return -1;
     }
+    key = ar.key;
+    nsec = ar.nsec;
+    osec = ar.osec;
+    npub = ar.npub;
+    pt = ar.pt;
+    ad = ar.ad;
+    xt = ar.xt;
+    ct = ar.ct;
 
     if (brutus_verbose) {
         printf("[%s] Coherence Check (limit=%d sec)  "
@@ -54,21 +63,21 @@ int test_coherence(caesar_t *aead, int limit)
             break;
         }
 
-        for (mlen = 0; mlen < sizeof(pt); mlen++) {
+        for (mlen = 0; mlen < COHERENCE_LEN; mlen++) {
 
             // clearup
-            memset(pt, 0x55, sizeof(pt));
-            memset(xt, 0xAA, sizeof(xt));
-            memset(ct, 0x33, sizeof(ct));
-            memset(ad, 0xCC, sizeof(ad));
-            memset(osec, 0xF0, sizeof(osec));
+            memset(pt, 0x55, COHERENCE_LEN);
+            memset(xt, 0xAA, COHERENCE_LEN);
+            memset(ct, 0x33, COHERENCE_LEN + aead->abytes);
+            memset(ad, 0xCC, COHERENCE_LEN);
+            memset(osec, 0xF0, aead->nsecbytes);
 
             // randomize cryptovariables
             detseq_fill(key, aead->keybytes);
             detseq_fill(nsec, aead->nsecbytes);
             detseq_fill(npub, aead->npubbytes);
 
-            adlen = detseq32() % (sizeof(ad) + 1);
+            adlen = detseq32() % (COHERENCE_LEN + 1);
             detseq_fill(ad, adlen);
             detseq_fill(pt, mlen);
 
@@ -79,7 +88,8 @@ int test_coherence(caesar_t *aead, int limit)
             if (ret != 0) {
                 fprintf(stderr,
                     "!ERROR\t%s encrypt(%llu)=%d\n", aead->name, mlen, ret);
-                return -1;
+                res = -1;
+                goto done;
             }
 
             // decrypt
@@ -87,7 +97,8 @@ int test_coherence(caesar_t *aead, int limit)
             if (ret != 0) {
                 fprintf(stderr,
                     "!ERROR\t%s decrypt(%llu)=%d\n", aead->name, clen, ret);
-                return -2;
+                res = -2;
+                goto done;
             }
 
             // check that the plaintext matches
@@ -96,14 +107,16 @@ int test_coherence(caesar_t *aead, int limit)
                     "!FAIL\t%s decrypt length=%llu "
                     "mlen=%llu adlen=%llu clen=%llu)\n",
                 aead->name, t, mlen, adlen, clen);
-                return -3;
+                res = -3;
+                goto done;
             }
             if (memcmp(pt, xt, mlen) != 0) {
                 fprintf(stderr,
                     "!FAIL\t%s decrypt mismatch "
                     "(mlen=%llu adlen=%llu clen=%llu\n)",
                     aead->name, mlen, adlen, clen);
-                return -4;
+                res = -4;
+                goto done;
             }
             if (aead->nsecbytes > 0 &&
                 memcmp(nsec, osec, aead->nsecbytes) != 0) {
@@ -111,7 +124,8 @@ int test_coherence(caesar_t *aead, int limit)
                     "!FAIL\t%s nsec mismatch "
                     "(mlen=%llu adlen=%llu clen=%llu\n)",
                     aead->name, mlen, adlen, clen);
-                return -5;
+                res = -5;
+                goto done;
             }
 
             // attempt random forgery
@@ -157,12 +171,16 @@ int test_coherence(caesar_t *aead, int limit)
             forge_try++;
         }
     }
+    res = 0;
     if (forge_ok > 0) {
         fprintf(stderr, "!FORGE\t%s %d/%d = %g forgeries.\n", aead->name,
             forge_ok, forge_try, ((double) forge_ok) / ((double) forge_try));
-        return -6;
+        res = -6;
     }
 
-    return 0;
+done:
+    arena_free(&ar);
+
+    return res;
 }
 
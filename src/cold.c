@@ -0,0 +1,321 @@
+// cold.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Cache-cold and large working set benchmark. Rotates through distinct
+// messages and keys spanning several times the last level cache, and
+// measures single calls with the data and the library itself flushed.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <link.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define COLD_HAVE_CLFLUSH
+#endif
+
+#include "brutus.h"
+
+// working set relative to the LLC, bounds, and cold-call sample cap
+#define COLD_FACTOR     4
+#define COLD_MIN        0x1000000
+#define COLD_MAX        0x40000000
+#define COLD_SAMPLES    10000
+
+typedef struct {
+    uint8_t *pt, *ct, *ad, *key, *nsec, *npub;
+} cold_slot_t;
+
+static size_t cold_gcd(size_t a, size_t b)
+{
+    size_t t;
+
+    while (b != 0) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+static size_t cold_round(size_t x)
+{
+    return (x + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+}
+
+// flush a memory range from all cache levels
+
+static void cold_flush(const void *p, size_t len)
+{
+#ifdef COLD_HAVE_CLFLUSH
+    const uint8_t *q = (const uint8_t *) p;
+    size_t i;
+
+    for (i = 0; i < len; i += ARENA_ALIGN)
+        _mm_clflush(q + i);
+    if (len > 0)
+        _mm_clflush(q + len - 1);
+    _mm_mfence();
+#endif
+}
+
+// flush the loaded segments (code, tables, state) of the shared library
+// that contains the address in data
+
+static int cold_phdr(struct dl_phdr_info *info, size_t size, void *data)
+{
+    int i, hit;
+    uintptr_t a, sym = (uintptr_t) data;
+
+    hit = 0;
+    for (i = 0; i < info->dlpi_phnum; i++) {
+        a = info->dlpi_addr + info->dlpi_phdr[i].p_vaddr;
+        if (info->dlpi_phdr[i].p_type == PT_LOAD &&
+            sym >= a && sym < a + info->dlpi_phdr[i].p_memsz)
+            hit = 1;
+    }
+    if (!hit)
+        return 0;
+
+    for (i = 0; i < info->dlpi_phnum; i++) {
+        if (info->dlpi_phdr[i].p_type == PT_LOAD) {
+            cold_flush((void *) (info->dlpi_addr +
+                info->dlpi_phdr[i].p_vaddr), info->dlpi_phdr[i].p_memsz);
+        }
+    }
+
+    return 1;
+}
+
+static void cold_flush_lib(void *sym)
+{
+    dl_iterate_phdr(cold_phdr, sym);
+}
+
+// encrypt slot s
+
+static int cold_call(caesar_t *aead, cold_slot_t *s,
+                    unsigned long long mlen, unsigned long long adlen)
+{
+    unsigned long long clen;
+    int ret;
+
+    clen = 0;
+    ret = aead->encrypt(s->ct, &clen, s->pt, mlen, s->ad, adlen,
+        s->nsec, s->npub, s->key);
+    if (ret != 0 || clen <= 0) {
+        fprintf(stderr, "!ERROR\t%s encrypt(%llu)=%d\n",
+            aead->name, mlen, ret);
+        return -1;
+    }
+
+    return 0;
+}
+
+// report latency statistics st of n single calls taking ticks in total
+
+static void cold_latency(caesar_t *aead, const char *what,
+                        unsigned long long mlen, unsigned long long adlen,
+                        stats_t *st, int n, double ticks, const char *json)
+{
+    double f, sec;
+    const char *unit;
+    char op[32];
+
+    snprintf(op, sizeof(op), "%s-latency", what);
+    sec = timer_sec(ticks);
+    if (brutus_format == FORMAT_TEXT) {
+        if (timer_cycles(1.0) > 0.0) {
+            f = timer_cycles(1.0);
+            unit = "c/call";
+        } else {
+            f = 1E9 * timer_sec(1.0);
+            unit = "ns/call";
+        }
+        printf("[%s] %s encrypt(mlen=%llu adlen=%llu) %s  n=%d/%d  "
+            "min=%.1f  med=%.1f  p90=%.1f\n", aead->name, what, mlen, adlen,
+            unit, st->kept, st->n, f * st->min, f * st->med, f * st->p90);
+    } else {
+        speed_row(aead, timer_name(), op, mlen, adlen, n, sec, st, json);
+    }
+    results_record(aead, op, mlen, adlen, st->kept,
+        1E9 * timer_sec(st->med), 1E9 * timer_sec(st->lo),
+        1E9 * timer_sec(st->hi), ((double) n) *
+        ((double) (mlen + adlen)) / sec / 1000.0);
+}
+
+int test_cold(caesar_t *aead, int limit)
+{
+    int ret, n, timer;
+    long llc;
+    size_t ws, ms, as, ks, nslots, i, step;
+    unsigned long long mlen, adlen, calls;
+    uint64_t tlim, stim, etim;
+    double *cold, *warm, csum, wsum, sec, ns;
+    stats_t cst, wst;
+    char json[40];
+    arena_t ar;
+    cold_slot_t *slot;
+
+    mlen = brutus_mlens.n > 0 ? brutus_mlens.len[0] : 1536;
+    adlen = brutus_adlens.n > 0 ? brutus_adlens.len[0] : 0;
+
+    // working set size from the last level cache
+    llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc <= 0)
+        llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (llc <= 0)
+        llc = 0x800000;
+    ws = COLD_FACTOR * (size_t) llc;
+    if (ws < COLD_MIN)
+        ws = COLD_MIN;
+    if (ws > COLD_MAX)
+        ws = COLD_MAX;
+
+    // per-slot strides; ad region also holds key, nsec and npub
+    ms = cold_round(mlen + aead->abytes);
+    ks = cold_round(aead->keybytes) + cold_round(aead->nsecbytes) +
+        cold_round(aead->npubbytes);
+    as = cold_round(adlen) + ks;
+    nslots = ws / (2 * ms + as);
+    if (nslots < 2)
+        nslots = 2;
+
+    if (brutus_verbose) {
+        printf("[%s] Cache-cold (limit=%d sec)  llc=%ld kB  ws=%zu kB  "
+            "slots=%zu  key=%d  nsec=%d  npub=%d  a=%d\n",
+            aead->name, limit, llc >> 10, ws >> 10, nslots,
+            aead->keybytes, aead->nsecbytes, aead->npubbytes, aead->abytes);
+        fflush(stdout);
+    }
+
+    // single calls are well below the resolution of clock(); switch to
+    // the TSC (or monotonic) timer for this test
+    timer = brutus_timer;
+    if (timer == TIMER_CLOCK) {
+        timer_init(TIMER_TSC);
+        fprintf(stderr, "!INFO\t%s cache-cold test timed with %s, "
+            "not clock\n", aead->name, timer_name());
+    }
+
+    ret = -1;
+    slot = NULL;
+    cold = NULL;
+    warm = NULL;
+    if (arena_alloc(&ar, aead, nslots * ms, nslots * as) != 0)
+        goto done;
+    slot = calloc(nslots, sizeof(cold_slot_t));
+    cold = calloc(COLD_SAMPLES, sizeof(double));
+    warm = calloc(COLD_SAMPLES, sizeof(double));
+    if (slot == NULL || cold == NULL || warm == NULL) {
+        perror("test_cold()");
+        ret = -1;
+        goto done;
+    }
+
+    detseq_fill(ar.pt, nslots * ms);
+    detseq_fill(ar.ad, nslots * as);
+    for (i = 0; i < nslots; i++) {
+        slot[i].pt = ar.pt + i * ms;
+        slot[i].ct = ar.ct + i * ms;
+        slot[i].ad = ar.ad + i * as;
+        slot[i].key = slot[i].ad + cold_round(adlen);
+        slot[i].nsec = slot[i].key + cold_round(aead->keybytes);
+        slot[i].npub = slot[i].nsec + cold_round(aead->nsecbytes);
+    }
+
+    // visit slots in a scattered order to defeat the prefetchers
+    step = (size_t) (0.618034 * nslots) | 1;
+    while (cold_gcd(nslots, step) != 1)
+        step += 2;
+
+    tlim = timer_ticks(limit) / 2;
+
+    // sustained throughput over the whole working set
+    i = 0;
+    calls = 0;
+    stim = timer_start();
+    do {
+        if ((ret = cold_call(aead, &slot[i], mlen, adlen)) != 0)
+            goto done;
+        i = (i + step) % nslots;
+        calls++;
+        etim = timer_read() - stim;
+    } while (etim < tlim);
+    etim = timer_stop() - stim;
+
+    sec = timer_sec(etim);
+    if (brutus_format == FORMAT_TEXT) {
+        printf("[%s] %.2f kB/s  sustained encrypt(mlen=%llu adlen=%llu)",
+            aead->name, ((double) calls) * ((double) (mlen + adlen)) /
+            sec / 1000.0, mlen, adlen);
+        if (timer_cycles(1.0) > 0.0)
+            printf("  %.0f c/call", timer_cycles(etim) / ((double) calls));
+        printf("\n");
+    } else {
+        speed_row(aead, timer_name(), "cold-sustained", mlen, adlen,
+            calls, sec, NULL, "");
+    }
+    ns = 1E9 * sec / ((double) calls);
+    results_record(aead, "cold-sustained", mlen, adlen, 0, ns, ns, ns,
+        ((double) calls) * ((double) (mlen + adlen)) / sec / 1000.0);
+
+    // single calls with slot and library flushed, then repeated warm
+    n = 0;
+    csum = 0.0;
+    wsum = 0.0;
+    stim = timer_read();
+    do {
+        cold_flush(slot[i].pt, mlen);
+        cold_flush(slot[i].ct, mlen + aead->abytes);
+        cold_flush(slot[i].ad, as);
+        cold_flush_lib(aead->encrypt);
+
+        etim = timer_start();
+        if ((ret = cold_call(aead, &slot[i], mlen, adlen)) != 0)
+            goto done;
+        cold[n] = (double) (timer_stop() - etim);
+        csum += cold[n];
+
+        etim = timer_start();
+        if ((ret = cold_call(aead, &slot[i], mlen, adlen)) != 0)
+            goto done;
+        warm[n] = (double) (timer_stop() - etim);
+        wsum += warm[n];
+
+        i = (i + step) % nslots;
+        n++;
+    } while (n < COLD_SAMPLES && timer_read() - stim < tlim);
+
+    stats_calc(&cst, cold, n);
+    stats_calc(&wst, warm, n);
+    snprintf(json, sizeof(json), ",\"ratio\":%.3f",
+        wst.med > 0.0 ? cst.med / wst.med : 0.0);
+    cold_latency(aead, "cold", mlen, adlen, &cst, n, csum, json);
+    cold_latency(aead, "warm", mlen, adlen, &wst, n, wsum, "");
+    if (brutus_format == FORMAT_TEXT && wst.med > 0.0) {
+        printf("[%s] cold/warm latency ratio %.2f\n",
+            aead->name, cst.med / wst.med);
+    }
+#ifndef COLD_HAVE_CLFLUSH
+    fprintf(stderr, "!INFO\tno clflush; cold calls rely on working set "
+        "eviction.\n");
+#endif
+    fflush(stdout);
+    ret = 0;
+
+done:
+    free(slot);
+    free(cold);
+    free(warm);
+    arena_free(&ar);
+    if (timer == TIMER_CLOCK)
+        timer_init(timer);
+
+    return ret;
+}
@@ -0,0 +1,96 @@
+// dispatch.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Load-time implementation selection for libraries built by
+// mkdispatch.sh. The generated dispatch_variants.h has one line per
+// linked implementation, preferred first:
+//
+//     DISPATCH_VARIANT(id, "name", cpu feature condition)
+//
+// The implementations' crypto_aead_* symbols have been renamed to
+// dispatch_<id>_encrypt / _decrypt; the first one whose features the
+// running CPU has is bound to crypto_aead_* through GNU ifunc, so code
+// for a missing instruction set is never entered.
+
+#include <stddef.h>
+
+#include "brutus_aead.h"
+
+typedef int (*dispatch_enc_t)(unsigned char *, unsigned long long *,
+    const unsigned char *, unsigned long long, const unsigned char *,
+    unsigned long long, const unsigned char *, const unsigned char *,
+    const unsigned char *);
+
+typedef int (*dispatch_dec_t)(unsigned char *, unsigned long long *,
+    unsigned char *, const unsigned char *, unsigned long long,
+    const unsigned char *, unsigned long long, const unsigned char *,
+    const unsigned char *);
+
+// renamed entry points; hidden so that only crypto_aead_* is exported
+
+#define DISPATCH_VARIANT(id, name, cond) \
+    __attribute__((visibility("hidden"))) int dispatch_ ## id ## _encrypt( \
+        unsigned char *, unsigned long long *, const unsigned char *, \
+        unsigned long long, const unsigned char *, unsigned long long, \
+        const unsigned char *, const unsigned char *, \
+        const unsigned char *); \
+    __attribute__((visibility("hidden"))) int dispatch_ ## id ## _decrypt( \
+        unsigned char *, unsigned long long *, unsigned char *, \
+        const unsigned char *, unsigned long long, const unsigned char *, \
+        unsigned long long, const unsigned char *, const unsigned char *);
+#include "dispatch_variants.h"
+#undef DISPATCH_VARIANT
+
+// resolvers run before constructors; initialize the cpuid data first
+
+static dispatch_enc_t dispatch_resolve_enc(void)
+{
+    __builtin_cpu_init();
+#define DISPATCH_VARIANT(id, name, cond) \
+    if (cond) \
+        return dispatch_ ## id ## _encrypt;
+#include "dispatch_variants.h"
+#undef DISPATCH_VARIANT
+
+    return NULL;
+}
+
+static dispatch_dec_t dispatch_resolve_dec(void)
+{
+    __builtin_cpu_init();
+#define DISPATCH_VARIANT(id, name, cond) \
+    if (cond) \
+        return dispatch_ ## id ## _decrypt;
+#include "dispatch_variants.h"
+#undef DISPATCH_VARIANT
+
+    return NULL;
+}
+
+int crypto_aead_encrypt(unsigned char *c, unsigned long long *clen,
+                        const unsigned char *m, unsigned long long mlen,
+                        const unsigned char *ad, unsigned long long adlen,
+                        const unsigned char *nsec, const unsigned char *npub,
+                        const unsigned char *k)
+    __attribute__((ifunc("dispatch_resolve_enc")));
+
+int crypto_aead_decrypt(unsigned char *m, unsigned long long *outputmlen,
+                        unsigned char *nsec,
+                        const unsigned char *c, unsigned long long clen,
+                        const unsigned char *ad, unsigned long long adlen,
+                        const unsigned char *npub, const unsigned char *k)
+    __attribute__((ifunc("dispatch_resolve_dec")));
+
+// name of the selected implementation, for brutus
+
+const char *brutus_variant()
+{
+    __builtin_cpu_init();
+#define DISPATCH_VARIANT(id, name, cond) \
+    if (cond) \
+        return name;
+#include "dispatch_variants.h"
+#undef DISPATCH_VARIANT
+
+    return "none";
+}
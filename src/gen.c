@@ -0,0 +1,188 @@
+// gen.c
+// 18-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Counter-based deterministic generator, detseq version 1 (-g1). Word n
+// of the stream is a keyed hash of the 64-bit counter n,
+//
+//     x = mix(lo(n) + k0),  word(n) = mix(x ^ (hi(n) + k1)),
+//
+// where mix() is a 32-bit xorshift-multiply finalizer. The byte stream is
+// the words in little-endian order, so any offset can be generated
+// directly and independent workers can take disjoint substreams. Bulk
+// fills compute 8 (AVX2) or 4 (SSE4.1) words per step.
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEN_X86
+#endif
+
+#include "brutus.h"
+
+#define GEN_M0  0x7FEB352D
+#define GEN_M1  0x846CA68B
+
+static inline uint32_t gen_mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= GEN_M0;
+    x ^= x >> 15;
+    x *= GEN_M1;
+    x ^= x >> 16;
+
+    return x;
+}
+
+// key for a seed. gen_key(g, 0) gives { GEN_K0, 0 }.
+
+void gen_key(gen_t *g, uint32_t seed)
+{
+    g->k0 = GEN_K0 * (seed + 1);
+    g->k1 = gen_mix(seed);
+}
+
+uint32_t gen_word(const gen_t *g, uint64_t n)
+{
+    return gen_mix(gen_mix(((uint32_t) n) + g->k0) ^
+        (((uint32_t) (n >> 32)) + g->k1));
+}
+
+// cnt words from lo within one high half hi, little-endian to out
+
+static void gen_ref(const gen_t *g, uint32_t lo, uint32_t hi,
+                    uint8_t *out, size_t cnt)
+{
+    size_t i;
+    uint32_t w;
+
+    hi += g->k1;
+    for (i = 0; i < cnt; i++) {
+        w = gen_mix(gen_mix(lo + i + g->k0) ^ hi);
+        out[4 * i] = w;
+        out[4 * i + 1] = w >> 8;
+        out[4 * i + 2] = w >> 16;
+        out[4 * i + 3] = w >> 24;
+    }
+}
+
+#ifdef GEN_X86
+
+__attribute__((target("sse4.1")))
+static inline __m128i gen_mix4(__m128i x)
+{
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    x = _mm_mullo_epi32(x, _mm_set1_epi32(GEN_M0));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+    x = _mm_mullo_epi32(x, _mm_set1_epi32(GEN_M1));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+
+    return x;
+}
+
+__attribute__((target("sse4.1")))
+static void gen_sse41(const gen_t *g, uint32_t lo, uint32_t hi,
+                    uint8_t *out, size_t cnt)
+{
+    size_t i;
+    __m128i c, h, x;
+
+    c = _mm_add_epi32(_mm_set1_epi32(lo + g->k0),
+        _mm_setr_epi32(0, 1, 2, 3));
+    h = _mm_set1_epi32(hi + g->k1);
+    for (i = 0; i + 4 <= cnt; i += 4) {
+        x = gen_mix4(_mm_xor_si128(gen_mix4(c), h));
+        _mm_storeu_si128((__m128i *) &out[4 * i], x);
+        c = _mm_add_epi32(c, _mm_set1_epi32(4));
+    }
+    gen_ref(g, lo + i, hi, &out[4 * i], cnt - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gen_mix8(__m256i x)
+{
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32(GEN_M0));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32(GEN_M1));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+
+    return x;
+}
+
+__attribute__((target("avx2")))
+static void gen_avx2(const gen_t *g, uint32_t lo, uint32_t hi,
+                    uint8_t *out, size_t cnt)
+{
+    size_t i;
+    __m256i c, h, x;
+
+    c = _mm256_add_epi32(_mm256_set1_epi32(lo + g->k0),
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    h = _mm256_set1_epi32(hi + g->k1);
+    for (i = 0; i + 8 <= cnt; i += 8) {
+        x = gen_mix8(_mm256_xor_si256(gen_mix8(c), h));
+        _mm256_storeu_si256((__m256i *) &out[4 * i], x);
+        c = _mm256_add_epi32(c, _mm256_set1_epi32(8));
+    }
+    gen_ref(g, lo + i, hi, &out[4 * i], cnt - i);
+}
+
+#endif
+
+// words n .. n + cnt - 1 to out (4 * cnt bytes, any alignment)
+
+void gen_words(const gen_t *g, uint64_t n, void *out, size_t cnt)
+{
+    static void (*bulk)(const gen_t *, uint32_t, uint32_t,
+        uint8_t *, size_t) = NULL;
+    uint64_t m;
+
+    if (bulk == NULL) {
+        bulk = gen_ref;
+#ifdef GEN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            bulk = gen_avx2;
+        else if (__builtin_cpu_supports("sse4.1"))
+            bulk = gen_sse41;
+#endif
+    }
+
+    // split where the low half of the counter wraps
+    while (cnt > 0) {
+        m = 0x100000000llu - (n & 0xFFFFFFFF);
+        if (m > cnt)
+            m = cnt;
+        bulk(g, (uint32_t) n, (uint32_t) (n >> 32), out, m);
+        n += m;
+        out = ((uint8_t *) out) + 4 * m;
+        cnt -= m;
+    }
+}
+
+// len bytes of the stream from byte offset off
+
+void gen_fill(const gen_t *g, uint64_t off, void *p, size_t len)
+{
+    size_t i, n;
+    uint32_t w;
+    uint8_t *b;
+
+    b = (uint8_t *) p;
+    for (; len > 0 && (off & 3) != 0; off++, len--)
+        *b++ = gen_word(g, off >> 2) >> (8 * (off & 3));
+
+    n = len >> 2;
+    gen_words(g, off >> 2, b, n);
+    b += 4 * n;
+    off += 4 * n;
+    len &= 3;
+
+    if (len > 0) {
+        w = gen_word(g, off >> 2);
+        for (i = 0; i < len; i++)
+            b[i] = w >> (8 * i);
+    }
+}
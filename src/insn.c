@@ -0,0 +1,270 @@
+// insn.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Deterministic cost model: retired user-space instructions per call,
+// counted exactly by single-stepping a traced child with ptrace. The
+// counts do not depend on load or clock and can be diffed across runs.
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/ptrace.h>
+
+#include "brutus.h"
+
+// default message lengths
+static unsigned long long insn_deflen[5] = { 0, 16, 64, 256, 1024 };
+
+// operations; INSN_NONE measures the tracing overhead
+
+#define INSN_NONE       0
+#define INSN_ENC        1
+#define INSN_DEC        2
+
+// exit status of a child whose call returned an error
+#define INSN_XFAIL      0x7F
+
+static int insn_op(caesar_t *aead, arena_t *ar, int op,
+                unsigned long long mlen, unsigned long long adlen,
+                unsigned long long *clen)
+{
+    unsigned long long t;
+
+    switch (op) {
+        case INSN_ENC:
+            return aead->encrypt(ar->ct, clen, ar->pt, mlen, ar->ad, adlen,
+                ar->nsec, ar->npub, ar->key);
+        case INSN_DEC:
+            return aead->decrypt(ar->xt, &t, ar->osec, ar->ct, *clen,
+                ar->ad, adlen, ar->npub, ar->key);
+        default:
+            return 0;
+    }
+}
+
+// count instructions of a single call. the child makes a warmup call
+// (lazy binding, first-touch page faults) and then brackets the measured
+// call with SIGSTOPs; the parent single-steps between them.
+// returns the count, -2 if a call returned an error, or -1 on other
+// errors / more than max steps.
+
+static long long insn_count(caesar_t *aead, arena_t *ar, int op,
+                        unsigned long long mlen, unsigned long long adlen,
+                        long long max)
+{
+    pid_t pid;
+    int st;
+    long long n;
+    unsigned long long clen;
+
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork()");
+        return -1;
+    }
+
+    if (pid == 0) {
+        clen = 0;
+        if (aead->encrypt(ar->ct, &clen, ar->pt, mlen, ar->ad, adlen,
+            ar->nsec, ar->npub, ar->key) != 0 ||
+            insn_op(aead, ar, op, mlen, adlen, &clen) != 0)
+            _exit(INSN_XFAIL);
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0)
+            _exit(2);
+        raise(SIGSTOP);
+        if (insn_op(aead, ar, op, mlen, adlen, &clen) != 0)
+            _exit(INSN_XFAIL);
+        raise(SIGSTOP);
+        _exit(0);
+    }
+
+    // first stop
+    n = -1;
+    st = 0;
+    if (waitpid(pid, &st, 0) != pid || !WIFSTOPPED(st)) {
+        if (WIFEXITED(st) && WEXITSTATUS(st) == INSN_XFAIL)
+            n = -2;
+        goto done;
+    }
+
+    // step until the second stop
+    for (n = 0; n <= max; n++) {
+        if (ptrace(PTRACE_SINGLESTEP, pid, NULL, NULL) != 0 ||
+            waitpid(pid, &st, 0) != pid || !WIFSTOPPED(st)) {
+            n = WIFEXITED(st) && WEXITSTATUS(st) == INSN_XFAIL ? -2 : -1;
+            break;
+        }
+        if (WSTOPSIG(st) != SIGTRAP) {
+            if (WSTOPSIG(st) != SIGSTOP)
+                n = -1;
+            break;
+        }
+    }
+    if (n > max)
+        n = -1;
+
+done:
+    kill(pid, SIGKILL);
+    waitpid(pid, &st, 0);
+
+    return n;
+}
+
+// print a fit of the counts y over lengths x
+
+static void insn_model(caesar_t *aead, int op, const char *what,
+                    double *x, double *y, int n)
+{
+    double a, b;
+    char name[48];
+
+    stats_linfit(x, y, n, &a, &b);
+    if (brutus_format == FORMAT_TEXT) {
+        printf("[%s] insn model %s = %.1f + %.3f/B (%s)\n", aead->name,
+            op == INSN_ENC ? "encrypt" : "decrypt", a, b, what);
+        return;
+    }
+    // per-call and per-byte parts as separate records
+    snprintf(name, sizeof(name), "insn-%s-fixed-%s",
+        op == INSN_ENC ? "encrypt" : "decrypt", what);
+    speed_count(aead, "insn", name, 0, 0, "insn/call", a, "");
+    snprintf(name, sizeof(name), "insn-%s-perbyte-%s",
+        op == INSN_ENC ? "encrypt" : "decrypt", what);
+    speed_count(aead, "insn", name, 0, 0, "insn/B", b, "");
+}
+
+int test_insn(caesar_t *aead, int limit)
+{
+    int ret, i, j, op, nl, na;
+    long long base, cnt, max;
+    unsigned long long maxm, maxa, zero = 0;
+    double *x, *y, *z;
+    lenlist_t ml, al;
+    arena_t ar;
+
+    ml = brutus_mlens;
+    if (ml.n == 0) {
+        ml.n = 5;
+        ml.len = insn_deflen;
+    }
+    al = brutus_adlens;
+    if (al.n == 0) {
+        al.n = 1;
+        al.len = &zero;
+    }
+    nl = ml.n;
+    na = al.n;
+    maxm = 0;
+    for (i = 0; i < nl; i++) {
+        if (ml.len[i] > maxm)
+            maxm = ml.len[i];
+    }
+    maxa = 0;
+    for (j = 0; j < na; j++) {
+        if (al.len[j] > maxa)
+            maxa = al.len[j];
+    }
+    max = 1000000LL * limit;
+
+    if (brutus_verbose) {
+        printf("[%s] Instruction Count (limit=%d M/call)  "
+            "key=%d  nsec=%d  npub=%d  a=%d\n",
+            aead->name, limit, aead->keybytes, aead->nsecbytes,
+            aead->npubbytes, aead->abytes);
+    }
+
+    // xt receives decrypted messages
+    if (arena_alloc(&ar, aead, maxm + aead->abytes, maxa) != 0)
+        return -1;
+    detseq_fill(ar.key, aead->keybytes);
+    detseq_fill(ar.nsec, aead->nsecbytes);
+    detseq_fill(ar.npub, aead->npubbytes);
+    detseq_fill(ar.pt, maxm);
+    detseq_fill(ar.ad, maxa);
+
+    x = calloc(nl + na, sizeof(double));
+    y = calloc(nl * na, sizeof(double));
+    z = calloc(nl + na, sizeof(double));
+    if (x == NULL || y == NULL || z == NULL) {
+        perror("test_insn()");
+        ret = -1;
+        goto done;
+    }
+
+    // tracing overhead, subtracted from every count
+    if ((base = insn_count(aead, &ar, INSN_NONE, 0, 0, max)) < 0) {
+        fprintf(stderr,
+            "!INFO\tcannot single-step child; no instruction counts.\n");
+        ret = -1;
+        goto done;
+    }
+
+    for (op = INSN_ENC; op <= INSN_DEC; op++) {
+        for (i = 0; i < nl; i++) {
+            for (j = 0; j < na; j++) {
+                cnt = insn_count(aead, &ar, op, ml.len[i], al.len[j], max);
+                if (cnt == -2) {
+                    fprintf(stderr, "!ERROR\t%s %s(mlen=%llu adlen=%llu) "
+                        "returned an error\n", aead->name,
+                        op == INSN_ENC ? "encrypt" : "decrypt",
+                        ml.len[i], al.len[j]);
+                    ret = -1;
+                    goto done;
+                }
+                if (cnt < 0) {
+                    fprintf(stderr, "!ERROR\t%s %s(mlen=%llu adlen=%llu) "
+                        "failed or over %d M instructions\n", aead->name,
+                        op == INSN_ENC ? "encrypt" : "decrypt",
+                        ml.len[i], al.len[j], limit);
+                    ret = -1;
+                    goto done;
+                }
+                cnt -= base;
+                y[i * na + j] = (double) cnt;
+                if (brutus_format == FORMAT_TEXT) {
+                    printf("[%s] insn %s(mlen=%llu adlen=%llu) %lld\n",
+                        aead->name, op == INSN_ENC ? "encrypt" : "decrypt",
+                        ml.len[i], al.len[j], cnt);
+                } else {
+                    speed_count(aead, "insn", op == INSN_ENC ?
+                        "insn-encrypt" : "insn-decrypt", ml.len[i],
+                        al.len[j], "insn/call", (double) cnt, "");
+                }
+            }
+        }
+
+        // per-call + per-byte over message length at the first adlen,
+        // per-byte of associated data at the first mlen
+        if (nl > 1) {
+            for (i = 0; i < nl; i++) {
+                x[i] = (double) ml.len[i];
+                z[i] = y[i * na];
+            }
+            insn_model(aead, op, "mlen", x, z, nl);
+        }
+        if (na > 1) {
+            for (j = 0; j < na; j++) {
+                x[j] = (double) al.len[j];
+                z[j] = y[j];
+            }
+            insn_model(aead, op, "adlen", x, z, na);
+        }
+        fflush(stdout);
+    }
+    ret = 0;
+
+done:
+    free(x);
+    free(y);
+    free(z);
+    arena_free(&ar);
+
+    return ret;
+}
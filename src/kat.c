@@ -10,13 +10,10 @@
 #include <dlfcn.h>
 #include <time.h>
 #include <ctype.h>
+#include <pthread.h>
 
 #include "brutus.h"
 
-#ifndef KAT_LIMIT
-#define KAT_LIMIT 0x10000
-#endif
-
 void kat_vec(void *p, int len, char *label)
 {
     int i;
@@ -26,80 +23,391 @@ void kat_vec(void *p, int len, char *label)
     printf("\n");
 }
 
-void do_kat(caesar_t *aead, int mlen, int adlen)
+// inputs of a vector from detseq
+
+static void kat_input(caesar_t *aead, arena_t *ar, int mlen, int adlen)
+{
+    memset(ar->pt, 0x00, ar->mlen);
+    memset(ar->ad, 0x00, ar->adlen);
+    memset(ar->ct, 0x00, ar->mlen + aead->abytes);
+    memset(ar->key, 0x00, aead->keybytes);
+    memset(ar->nsec, 0x00, aead->nsecbytes);
+    memset(ar->npub, 0x00, aead->npubbytes);
+
+    detseq_fill(ar->key, aead->keybytes);
+    detseq_fill(ar->pt, mlen);
+    detseq_fill(ar->ad, adlen);
+    detseq_fill(ar->npub, aead->npubbytes);
+    detseq_fill(ar->nsec, aead->nsecbytes);
+}
+
+void do_kat(caesar_t *aead, arena_t *ar, int mlen, int adlen)
 {
     int ret;
     unsigned long long clen;
 
-    uint8_t key[80], nsec[64], osec[64], npub[64];
-    // that 524304 ABYTES factor comes from Trivia. Don't ask.
-    uint8_t pt[KAT_LIMIT], ad[KAT_LIMIT], ct[KAT_LIMIT + 524304];
-
-    if (aead->name == NULL ||
-        aead->abytes + sizeof(pt) > sizeof(ct) ||
-        aead->keybytes > sizeof(key) || aead->nsecbytes > sizeof(nsec) ||
-        aead->nsecbytes > sizeof(osec) || aead->npubbytes > sizeof(npub)) {
-        fprintf(stderr, "do_kat(): invalid parameters\n");
-    }
-
-    memset(pt, 0x00, sizeof(pt));
-    memset(ad, 0x00, sizeof(ad));
-    memset(ct, 0x00, sizeof(ct));
-    memset(key, 0x00, sizeof(key));
-    memset(nsec, 0x00, sizeof(nsec));
-    memset(npub, 0x00, sizeof(npub));
-
-    detseq_fill(key, aead->keybytes);
-    detseq_fill(pt, mlen);
-    detseq_fill(ad, adlen);
-    detseq_fill(npub, aead->npubbytes);
-    detseq_fill(nsec, aead->nsecbytes);
-
-    kat_vec(key, aead->keybytes, "key");
-    kat_vec(nsec, aead->nsecbytes, "nsec");
-    kat_vec(npub, aead->npubbytes, "npub");
-    kat_vec(pt, mlen, "m");
-    kat_vec(ad, adlen, "ad");
-
-    ret = aead->encrypt(ct, &clen, pt, mlen,
-        ad, adlen, nsec, npub, key);
+    kat_input(aead, ar, mlen, adlen);
+
+    kat_vec(ar->key, aead->keybytes, "key");
+    kat_vec(ar->nsec, aead->nsecbytes, "nsec");
+    kat_vec(ar->npub, aead->npubbytes, "npub");
+    kat_vec(ar->pt, mlen, "m");
+    kat_vec(ar->ad, adlen, "ad");
+
+    ret = aead->encrypt(ar->ct, &clen, ar->pt, mlen,
+        ar->ad, adlen, ar->nsec, ar->npub, ar->key);
     if (ret != 0) {
         printf("[%s] encrypt failed with code %d\n", aead->name, ret);
         return;
     }
-    kat_vec(ct, clen, "c");
+    kat_vec(ar->ct, clen, "c");
     printf("\n");
 }
 
 int test_kat(caesar_t *aead, int limit)
 {
     int len, t;
+    arena_t ar;
 
-    if (brutus_verbose) {
+    // vectors of another generator are marked even when quiet
+    if (brutus_verbose || brutus_detseq != DETSEQ_FIB) {
         printf("[%s] KAT (limit=%d bytes)  "
-            "key=%d  nsec=%d  npub=%d  a=%d\n",
+            "key=%d  nsec=%d  npub=%d  a=%d",
             aead->name, limit, aead->keybytes, aead->nsecbytes,
             aead->npubbytes, aead->abytes);
+        if (brutus_detseq != DETSEQ_FIB)
+            printf("  detseq=%d", brutus_detseq);
+        printf("\n");
     }
-    if (limit > KAT_LIMIT) {
-        fprintf(stderr, "Limit too high. Increse KAT_LIMIT macro (%d).\n",
-            KAT_LIMIT);
+    if (aead->name == NULL || arena_alloc(&ar, aead, limit, limit) != 0) {
+        fprintf(stderr, "test_kat(): invalid parameters\n");
         return -1;
     }
 
     detseq_seed(-1);
-    do_kat(aead, 0, 0);
+    do_kat(aead, &ar, 0, 0);
 
     for (len = 1; len <= limit; len++) {
         detseq_seed(len);
-        do_kat(aead, len, 0);
-        do_kat(aead, 0, len);
+        do_kat(aead, &ar, len, 0);
+        do_kat(aead, &ar, 0, len);
         if (len > 1) {
             t = detseq32() % (len - 1) + 1;
-            do_kat(aead, t, len - t);
+            do_kat(aead, &ar, t, len - t);
         }
     }
+    arena_free(&ar);
 
     return 0;
 }
 
+
+// Digest mode (-d). The vectors of test_kat() are hashed instead of
+// printed, KAT_VECS slots per length; the lengths are independently
+// seeded, so with -j they are split over threads, each with its own
+// detseq. The candidate's digest is the hash of the vector digests in
+// order. Variants of a cipher are checked against the reference one and
+// the first vector that differs is printed for both.
+
+#define KAT_VECS        3
+
+typedef struct {
+    pthread_t tid;
+    caesar_t *aead;
+    int first, step, limit;
+    uint64_t *dig;
+    int ret;
+} kat_thr_t;
+
+// one vector; printed like do_kat() if show is set
+
+static uint64_t kat_hash(caesar_t *aead, arena_t *ar, int mlen, int adlen,
+                        int show)
+{
+    int ret;
+    unsigned long long clen;
+    uint64_t h;
+
+    kat_input(aead, ar, mlen, adlen);
+    if (show) {
+        kat_vec(ar->key, aead->keybytes, "key");
+        kat_vec(ar->nsec, aead->nsecbytes, "nsec");
+        kat_vec(ar->npub, aead->npubbytes, "npub");
+        kat_vec(ar->pt, mlen, "m");
+        kat_vec(ar->ad, adlen, "ad");
+    }
+
+    h = HASH_FNV_INIT;
+    h = hash_fnv(h, &aead->keybytes, sizeof(int));
+    h = hash_fnv(h, ar->key, aead->keybytes);
+    h = hash_fnv(h, &aead->nsecbytes, sizeof(int));
+    h = hash_fnv(h, ar->nsec, aead->nsecbytes);
+    h = hash_fnv(h, &aead->npubbytes, sizeof(int));
+    h = hash_fnv(h, ar->npub, aead->npubbytes);
+    h = hash_fnv(h, &mlen, sizeof(int));
+    h = hash_fnv(h, ar->pt, mlen);
+    h = hash_fnv(h, &adlen, sizeof(int));
+    h = hash_fnv(h, ar->ad, adlen);
+
+    clen = 0;
+    ret = aead->encrypt(ar->ct, &clen, ar->pt, mlen,
+        ar->ad, adlen, ar->nsec, ar->npub, ar->key);
+    h = hash_fnv(h, &ret, sizeof(int));
+    if (ret != 0) {
+        if (show)
+            printf("[%s] encrypt failed with code %d\n", aead->name, ret);
+        return h;
+    }
+    if (clen > (unsigned long long) mlen + aead->abytes)
+        clen = mlen + aead->abytes;
+    h = hash_fnv(h, &clen, sizeof(clen));
+    h = hash_fnv(h, ar->ct, clen);
+    if (show)
+        kat_vec(ar->ct, clen, "c");
+
+    return h;
+}
+
+// the vectors of one length, as in test_kat(); vector show is printed
+
+static void kat_length(caesar_t *aead, arena_t *ar, int len, uint64_t *dig,
+                        int show)
+{
+    int t;
+
+    if (len == 0) {
+        detseq_seed(-1);
+        dig[0] = kat_hash(aead, ar, 0, 0, show == 0);
+        return;
+    }
+    detseq_seed(len);
+    dig[0] = kat_hash(aead, ar, len, 0, show == 0);
+    dig[1] = kat_hash(aead, ar, 0, len, show == 1);
+    if (len > 1) {
+        t = detseq32() % (len - 1) + 1;
+        dig[2] = kat_hash(aead, ar, t, len - t, show == 2);
+    }
+}
+
+static void *kat_worker(void *arg)
+{
+    int len;
+    arena_t ar;
+    kat_thr_t *th = (kat_thr_t *) arg;
+
+    if (arena_alloc(&ar, th->aead, th->limit, th->limit) != 0) {
+        th->ret = -1;
+        return NULL;
+    }
+    for (len = th->first; len <= th->limit; len += th->step)
+        kat_length(th->aead, &ar, len, &th->dig[KAT_VECS * len], -1);
+    arena_free(&ar);
+    th->ret = 0;
+
+    return NULL;
+}
+
+// vector digests of one candidate. lengths are
+// dealt out round-robin as the cost grows with the length.
+
+static int kat_digest(caesar_t *aead, int limit, int threads, uint64_t *dig)
+{
+    int i, ret;
+    kat_thr_t *th;
+
+    if ((th = calloc(threads, sizeof(kat_thr_t))) == NULL) {
+        perror("kat_digest()");
+        return -1;
+    }
+    for (i = 0; i < threads; i++) {
+        th[i].aead = aead;
+        th[i].first = i;
+        th[i].step = threads;
+        th[i].limit = limit;
+        th[i].dig = dig;
+        th[i].ret = -1;
+        if (pthread_create(&th[i].tid, NULL, kat_worker, &th[i]) != 0) {
+            perror("pthread_create()");
+            break;
+        }
+    }
+    ret = i == threads ? 0 : -1;
+    while (--i >= 0) {
+        pthread_join(th[i].tid, NULL);
+        if (th[i].ret != 0)
+            ret = -1;
+    }
+    free(th);
+
+    return ret;
+}
+
+// the candidate run by test_digest() and test_show(): thread count and
+// the file that digests come back in, so that a stray write in a child
+// cannot reach them
+
+static int kat_threads = 1;
+static int kat_limit = 0;
+static int kat_fd = -1;
+
+// vector digests of a candidate to kat_fd, run by test_harness()
+
+int test_digest(caesar_t *aead, int limit)
+{
+    int ret;
+    size_t len;
+    uint64_t *dig;
+
+    len = KAT_VECS * (limit + 1) * sizeof(uint64_t);
+    if ((dig = calloc(1, len)) == NULL) {
+        perror("test_digest()");
+        return -1;
+    }
+    ret = kat_digest(aead, limit, kat_threads, dig);
+    if (ret == 0 && pwrite(kat_fd, dig, len, 0) != (ssize_t) len)
+        ret = -1;
+    free(dig);
+
+    return ret;
+}
+
+// print vector v of a candidate
+
+static int test_show(caesar_t *aead, int v)
+{
+    arena_t ar;
+    uint64_t dig[KAT_VECS];
+
+    if (arena_alloc(&ar, aead, kat_limit, kat_limit) != 0)
+        return -1;
+    printf("[%s]\n", aead->name);
+    kat_length(aead, &ar, v / KAT_VECS, dig, v % KAT_VECS);
+    printf("\n");
+    arena_free(&ar);
+
+    return 0;
+}
+
+// digests of candidate with threads; 0 if complete
+
+static int kat_cand(caesar_t *aead, int limit, int threads, uint64_t *dig)
+{
+    ssize_t len;
+
+    len = KAT_VECS * (limit + 1) * sizeof(uint64_t);
+    kat_threads = threads;
+    if (ftruncate(kat_fd, 0) != 0 ||
+        test_harness(test_digest, aead, limit) != 0 ||
+        pread(kat_fd, dig, len, 0) != len)
+        return -1;
+
+    return 0;
+}
+
+int kat_digest_run(caesar_t *cand, int ciphers, int limit, int threads)
+{
+    int i, j, pfx, ref, nvec, *ok;
+    uint64_t *dig, *one, h;
+    FILE *f;
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > limit + 1)
+        threads = limit + 1;
+    nvec = KAT_VECS * (limit + 1);
+    kat_limit = limit;
+
+    dig = calloc((size_t) ciphers * nvec, sizeof(uint64_t));
+    one = calloc(nvec, sizeof(uint64_t));
+    ok = calloc(ciphers, sizeof(int));
+    if (dig == NULL || one == NULL || ok == NULL || (f = tmpfile()) == NULL) {
+        perror("kat_digest_run()");
+        free(dig);
+        free(one);
+        free(ok);
+        return -1;
+    }
+    kat_fd = fileno(f);
+
+    for (i = 0; i < ciphers; i++) {
+        if (brutus_verbose) {
+            printf("[%s] KAT digest (limit=%d bytes, threads=%d)  "
+                "key=%d  nsec=%d  npub=%d  a=%d\n",
+                cand[i].name, limit, threads, cand[i].keybytes,
+                cand[i].nsecbytes, cand[i].npubbytes, cand[i].abytes);
+        }
+        fflush(stdout);
+        harness_budget(harness_unit());
+        harness_spend(1.0);
+        ok[i] = kat_cand(&cand[i], limit, threads, &dig[i * nvec]) == 0;
+        if (!ok[i]) {
+            fprintf(stderr, "!FAIL\t%s KAT digest did not complete\n",
+                cand[i].name);
+            continue;
+        }
+        h = hash_fnv(HASH_FNV_INIT, &dig[i * nvec], nvec * sizeof(uint64_t));
+        printf("[%s] KAT %016llX  (0..%d)", cand[i].name,
+            (unsigned long long) h, limit);
+        if (brutus_detseq != DETSEQ_FIB)
+            printf("  detseq=%d", brutus_detseq);
+        printf("\n");
+        fflush(stdout);
+    }
+    harness_budget(0.0);
+
+    // variants against the -ref implementation of the cipher, or the
+    // first one that completed
+    for (i = 0; i < ciphers; i++) {
+        if (!ok[i])
+            continue;
+        pfx = name_prefix(cand[i].name);
+        ref = -1;
+        for (j = 0; j < ciphers; j++) {
+            if (!ok[j] || name_prefix(cand[j].name) != pfx ||
+                strncmp(cand[i].name, cand[j].name, pfx) != 0)
+                continue;
+            if (ref < 0 || strcmp(&cand[j].name[pfx], "-ref") == 0)
+                ref = j;
+        }
+        if (ref == i)
+            continue;
+
+        // with threads, a candidate that is not reentrant differs from
+        // itself; both are checked single-threaded (ok = 2) before one
+        // is blamed
+        for (j = 0; j < nvec; j++) {
+            if (dig[i * nvec + j] != dig[ref * nvec + j])
+                break;
+        }
+        if (j < nvec && threads > 1 && (ok[i] == 1 || ok[ref] == 1)) {
+            for (j = 0; j < ciphers; j++) {
+                if (ok[j] != 1 || (j != i && j != ref))
+                    continue;
+                ok[j] = kat_cand(&cand[j], limit, 1, one) == 0 ? 2 : 0;
+                if (ok[j] && memcmp(one, &dig[j * nvec],
+                    nvec * sizeof(uint64_t)) != 0) {
+                    printf("!INFO\t%s KAT digest depends on the number "
+                        "of threads\n", cand[j].name);
+                    memcpy(&dig[j * nvec], one, nvec * sizeof(uint64_t));
+                }
+            }
+            i--;
+            continue;
+        }
+        if (j < nvec) {
+            printf("!MISMATCH\t%s KAT differs from %s at length %d "
+                "vector %d\n", cand[i].name, cand[ref].name,
+                j / KAT_VECS, j % KAT_VECS);
+            fflush(stdout);
+            test_harness(test_show, &cand[ref], j);
+            test_harness(test_show, &cand[i], j);
+        }
+    }
+
+    fclose(f);
+    free(ok);
+    free(one);
+    free(dig);
+
+    return 0;
+}
@@ -17,6 +17,10 @@
 
 // global flags
 int brutus_verbose;
+int brutus_reps;
+int brutus_format;
+int brutus_threads;
+lenlist_t brutus_mlens, brutus_adlens;
 
 const char brutus_usage[] =
     "Usage: brutus [flags] aead1.so aead2.so ..\n"
@@ -27,7 +31,30 @@ const char brutus_usage[] =
     "  -rN  Use random seed N\n"
     "  -cN  Coherence test (N sec timeout)\n"
     "  -sN  Encryption/Authentication Speed (N secs each)\n"
-    "  -fN  Fast throughput test (N secs for enc/dec)\n";
+    "  -fN  Fast throughput test (N secs for enc/dec)\n"
+    "  -mN  Timer: 0=clock() 1=monotonic 2=TSC 3=perf cycles\n"
+    "  -nN  Warmup + N repetitions with robust statistics (-s, -f)\n"
+    "  -lL  Message lengths for -s, e.g. 0,40,1500 16:64K:*4 0:256:+32\n"
+    "  -aL  Associated data lengths for -s (mlen x adlen grid)\n"
+    "  -oN  Output format: 0=text 1=CSV 2=JSON lines\n"
+    "  -pN  Run -f / -s as a thread scaling test with 1..N threads\n"
+    "  -jN  Run -c, -k, -x in a pool of N workers (speed serialized)\n"
+    "  -b   Back test buffers with hugepages\n"
+    "  -wN  Alignment test: pt/ct/ad offsets 0..63 (N secs total)\n"
+    "  -iN  In-place vs out-of-place enc/dec (N secs total)\n"
+    "  -eN  Cache-cold test: working set > LLC, flushed calls (N secs)\n"
+    "  -KN  Key agility: new key every 1, 8, 64, inf messages (N secs)\n"
+    "  -MS  Packet mix S: imix, tls or trace file of \"mlen adlen\" lines\n"
+    "  -P   Hardware counters (IPC, cache / branch misses) with -s, -f\n"
+    "  -IN  Exact instruction counts and cost model (max N M insn/call)\n"
+    "  -DF  Append speed results to database file F\n"
+    "  -CF  Compare speed results against baseline file F\n"
+    "  -BN  Rank implementations per cipher, write aeadbest.txt (N secs)\n"
+    "  -AF  Write the -B selection to manifest file F instead\n"
+    "  -X   In-process tests; fork crashed candidates, serial tests with -T\n"
+    "  -TN  Kill tests after N secs; with -t split its time over candidates\n"
+    "  -gN  Test data generator: 0=Fibonacci (KATs) 1=counter, vectorized\n"
+    "  -dN  KAT digest per candidate; first differing vector of variants\n";
 //  "  -xN  Experimental -- parameter N.\n";
 
 
@@ -44,21 +71,40 @@ void timeout_kill(int sig)
 
 int main(int argc, char **argv)
 {
-    int t, i, *ipt, ciphers;
-    char *str;
+    int t, i, *ipt, ciphers, ntests, nserial;
+    double units;
+    char *str, *baseline;
+    const char *(*variant)();
     caesar_t *aead, *candidate;
     int flag_coherence, flag_speed, flag_fast, flag_xprmt,
-        flag_kat, flag_timeout;
+        flag_kat, flag_timeout, flag_timer, flag_jobs, flag_align,
+        flag_inplace, flag_cold, flag_agility, flag_mix, flag_insn,
+        flag_best, flag_digest;
+    sched_test_t tests[2];
     struct sigaction sa;
 
     // test modes
     brutus_verbose = 1;
+    brutus_reps = 0;
+    brutus_format = FORMAT_TEXT;
+    brutus_threads = 0;
     flag_coherence = 0;
     flag_speed = 0;
     flag_fast = 0;
     flag_xprmt = 0;
     flag_kat = 0;
     flag_timeout = 0;
+    flag_timer = TIMER_CLOCK;
+    flag_jobs = 0;
+    flag_align = 0;
+    flag_inplace = 0;
+    flag_cold = 0;
+    flag_agility = 0;
+    flag_mix = 0;
+    flag_insn = 0;
+    flag_best = 0;
+    flag_digest = 0;
+    baseline = NULL;
 
     // no paramets
     if (argc < 2) {
@@ -67,7 +113,12 @@ int main(int argc, char **argv)
     }
 
     // approximate table sizes
-    if ((candidate = calloc(argc, sizeof(caesar_t))) == NULL) {
+#ifdef BRUTUS_BUNDLE
+    t = argc * bundle_size();
+#else
+    t = argc;
+#endif
+    if ((candidate = calloc(t, sizeof(caesar_t))) == NULL) {
         perror("calloc()");
         return -1;
     }
@@ -92,6 +143,86 @@ int main(int argc, char **argv)
             // for future
             switch(argv[i][1]) {
 
+                case 'a':       // associated data lengths
+                case 'l':       // message lengths
+                    if (parse_lengths(argv[i][1] == 'a' ?
+                        &brutus_adlens : &brutus_mlens, &argv[i][2]) <= 0) {
+                        fprintf(stderr, "%s: Bad length list: %s\n",
+                            argv[0], argv[i]);
+                        return -1;
+                    }
+                    break;
+
+                case 'b':       // hugepage buffers
+                    brutus_hugepages = 1;
+                    break;
+
+                case 'B':       // best implementation
+                    if (t <= 0)
+                        flag_best = 1;
+                    else
+                        flag_best = t;
+                    break;
+
+                case 'A':       // best selection manifest
+                case 'C':       // compare against baseline
+                case 'D':       // results database
+                    if (argv[i][2] == 0) {
+                        fprintf(stderr, "%s: No file name: %s\n",
+                            argv[0], argv[i]);
+                        return -1;
+                    }
+                    if (argv[i][1] == 'A')
+                        brutus_best = &argv[i][2];
+                    else if (argv[i][1] == 'C')
+                        baseline = &argv[i][2];
+                    else
+                        brutus_db = &argv[i][2];
+                    break;
+
+                case 'I':       // instruction counts
+                    if (t <= 0)
+                        flag_insn = 10;
+                    else
+                        flag_insn = t;
+                    break;
+
+                case 'K':       // key agility
+                    if (t <= 0)
+                        flag_agility = 4;
+                    else
+                        flag_agility = t;
+                    break;
+
+                case 'P':       // performance counters
+                    brutus_pmu = 1;
+                    break;
+
+                case 'X':       // in-process isolation
+                    brutus_inproc = 1;
+                    break;
+
+                case 'T':       // per-test watchdog
+                    brutus_tlimit = t > 0 ? t : 60;
+                    break;
+
+                case 'g':       // deterministic sequence version
+                    if (t < 0)
+                        t = DETSEQ_CTR;
+                    if (t > DETSEQ_MAX) {
+                        fprintf(stderr, "%s: Unknown generator: %s\n",
+                            argv[0], argv[i]);
+                        return -1;
+                    }
+                    brutus_detseq = t;
+                    break;
+
+                case 'M':       // packet mix, 3 secs
+                    if (argv[i][2] != 0)
+                        brutus_mix = &argv[i][2];
+                    flag_mix = 3;
+                    break;
+
                 case 'c':       // coherence
                     if (t <= 0)
                         flag_coherence = 2;
@@ -99,6 +230,13 @@ int main(int argc, char **argv)
                         flag_coherence = t;
                     break;
 
+                case 'e':       // cache-cold
+                    if (t <= 0)
+                        flag_cold = 4;
+                    else
+                        flag_cold = t;
+                    break;
+
                 case 'f':       // throughput
                     if (t <= 0)
                         flag_fast = 1;
@@ -110,6 +248,27 @@ int main(int argc, char **argv)
                     printf("%s", brutus_usage);
                     return 0;
 
+                case 'i':       // in-place
+                    if (t <= 0)
+                        flag_inplace = 4;
+                    else
+                        flag_inplace = t;
+                    break;
+
+                case 'j':       // parallel jobs
+                    if (t <= 0)
+                        flag_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+                    else
+                        flag_jobs = t;
+                    break;
+
+                case 'd':       // KAT digests
+                    if (t <= 0)
+                        flag_digest = 100;
+                    else
+                        flag_digest = t;
+                    break;
+
                 case 'k':       // known answer tests
                     if (t <= 0)
                         flag_kat = 100;
@@ -117,6 +276,20 @@ int main(int argc, char **argv)
                         flag_kat = t;
                     break;
 
+                case 'm':       // timer method
+                    if (t < 0)
+                        flag_timer = TIMER_TSC;
+                    else
+                        flag_timer = t;
+                    break;
+
+                case 'n':       // repetitions
+                    if (t <= 0)
+                        brutus_reps = 20;
+                    else
+                        brutus_reps = t;
+                    break;
+
                 case 'r':       // random seed
                     if (t < 0)
                         t = time(NULL) & 0x7FFFFFFF;
@@ -139,10 +312,33 @@ int main(int argc, char **argv)
                         flag_timeout = 0;
                     break;
 
+                case 'o':       // output format
+                    if (t < 0 || t > FORMAT_JSON) {
+                        fprintf(stderr, "%s: Unknown format: %s\n",
+                            argv[0], argv[i]);
+                        return -1;
+                    }
+                    brutus_format = t;
+                    break;
+
+                case 'p':       // threads
+                    if (t <= 0)
+                        brutus_threads = sysconf(_SC_NPROCESSORS_ONLN);
+                    else
+                        brutus_threads = t;
+                    break;
+
                 case 'q':       // quiet
                     brutus_verbose = 0;
                     break;
 
+                case 'w':       // alignment
+                    if (t <= 0)
+                        flag_align = 8;
+                    else
+                        flag_align = t;
+                    break;
+
                 case 'x':       // experiment
                     if (t > 0)
                         flag_xprmt = t;
@@ -158,9 +354,17 @@ int main(int argc, char **argv)
 
         } else {
 
+#ifdef BRUTUS_BUNDLE
+            // linked in statically; arguments are names or patterns
+            if ((t = bundle_find(&candidate[ciphers], argv[i])) == 0)
+                fprintf(stderr, "%s: not in bundle\n", argv[i]);
+            ciphers += t;
+            continue;
+#endif
             aead = &candidate[ciphers];
             memset(aead, 0, sizeof(caesar_t));
 
+            aead->file = argv[i];
             aead->dlib = dlopen(argv[i], RTLD_LAZY | RTLD_LOCAL);
             str = dlerror();
             if (str != NULL)
@@ -202,6 +406,10 @@ int main(int argc, char **argv)
         }
     }
 
+    // structured output is not mixed with chatter
+    if (brutus_format != FORMAT_TEXT)
+        brutus_verbose = 0;
+
     // banner
     if (brutus_verbose) {
         printf("%s\n",
@@ -209,6 +417,18 @@ int main(int argc, char **argv)
         fflush(stdout);
     }
 
+    // implementations picked by dispatching libraries (mkdispatch.sh)
+    if (brutus_verbose) {
+        for (i = 0; i < ciphers; i++) {
+            if (candidate[i].dlib != NULL &&
+                (variant = (const char *(*)()) dlsym(candidate[i].dlib,
+                "brutus_variant")) != NULL)
+                printf("\t%s dispatches to %s\n", candidate[i].name,
+                    variant());
+        }
+        fflush(stdout);
+    }
+
     if (ciphers <= 0) {
         fprintf(stderr, "%s: No ciphers specified.\n", argv[0]);
         return 1;
@@ -229,31 +449,129 @@ int main(int argc, char **argv)
             perror("sigaction()");
 
         alarm(flag_timeout);
+
+        // a hung candidate is killed instead; shares of the remaining
+        // time go to the remaining candidates
+        if (brutus_tlimit > 0.0)
+            harness_deadline(flag_timeout);
+    }
+
+    // results store and baseline
+    if (brutus_db != NULL || baseline != NULL) {
+        results_init();
+        if (baseline != NULL && results_load(baseline) < 0)
+            return 1;
+    }
+
+    // calibrate the timer for speed tests
+    if (flag_speed > 0 || flag_fast > 0 || flag_align > 0 ||
+        flag_inplace > 0 || flag_cold > 0 || flag_agility > 0 ||
+        flag_mix > 0 || flag_best > 0) {
+        timer_init(flag_timer);
+        if (brutus_pmu && pmu_init() <= 0) {
+            fprintf(stderr, "!INFO\tno hardware performance counters; "
+                "timer only.\n");
+            brutus_pmu = 0;
+        }
+        speed_header();
+    }
+
+    // correctness tests run in parallel, the rest serially
+    ntests = 0;
+    if (flag_jobs > 0) {
+        if (flag_coherence > 0) {
+            tests[ntests].func = test_coherence;
+            tests[ntests++].val = flag_coherence;
+        }
+        if (flag_kat > 0) {
+            tests[ntests].func = test_kat;
+            tests[ntests++].val = flag_kat;
+        }
     }
+    nserial = (flag_coherence > 0 && flag_jobs == 0) +
+        (brutus_threads > 0 && (flag_speed > 0 || flag_fast > 0) ? 1 :
+        (flag_speed > 0) + (flag_fast > 0)) +
+        (flag_align > 0) + (flag_inplace > 0) + (flag_cold > 0) +
+        (flag_agility > 0) + (flag_mix > 0) + (flag_insn > 0) +
+        (flag_kat > 0 && flag_jobs == 0);
+
+    // shares of the run (-t -T): units of work, see harness_plan()
+    units = ciphers * nserial + (flag_best > 0 ? ciphers : 0) +
+        (flag_digest > 0 ? ciphers : 0);
+    if (ntests > 0) {
+        t = ciphers * ntests;
+        units += (double) t / (flag_jobs < t ? flag_jobs : t);
+    }
+    harness_plan(units);
+
+    // best implementation of each cipher
+    if (flag_best > 0)
+        best_run(candidate, ciphers, flag_best);
+
+    // KAT digests; lengths are split over threads only when asked (-j)
+    // as a candidate need not be reentrant
+    if (flag_digest > 0) {
+        kat_digest_run(candidate, ciphers, flag_digest,
+            flag_jobs > 0 ? flag_jobs : 1);
+    }
+
+    // correctness tests in parallel first
+    if (ntests > 0)
+        sched_run(candidate, ciphers, tests, ntests, flag_jobs);
 
-    // run tests on all ciphers
+    // run tests on all ciphers; timing-sensitive ones strictly serialized
     for (i = 0; i < ciphers; i++) {
-        if (flag_coherence > 0)
+        harness_budget(harness_unit() * nserial);
+        harness_spend(nserial);
+        if (flag_coherence > 0 && flag_jobs == 0)
             test_harness(test_coherence, &candidate[i], flag_coherence);
-        if (flag_speed > 0)
-            test_harness(test_speed, &candidate[i], flag_speed);
-        if (flag_fast > 0)
-            test_harness(test_throughput, &candidate[i], flag_fast);
-        if (flag_kat > 0)
+        if (brutus_threads > 0 && (flag_speed > 0 || flag_fast > 0)) {
+            test_harness(test_scaling, &candidate[i],
+                flag_fast > 0 ? flag_fast : flag_speed);
+        } else {
+            if (flag_speed > 0)
+                test_harness(test_speed, &candidate[i], flag_speed);
+            if (flag_fast > 0)
+                test_harness(test_throughput, &candidate[i], flag_fast);
+        }
+        if (flag_align > 0)
+            test_harness(test_align, &candidate[i], flag_align);
+        if (flag_inplace > 0)
+            test_harness(test_inplace, &candidate[i], flag_inplace);
+        if (flag_cold > 0)
+            test_harness(test_cold, &candidate[i], flag_cold);
+        if (flag_agility > 0)
+            test_harness(test_agility, &candidate[i], flag_agility);
+        if (flag_mix > 0)
+            test_harness(test_mix, &candidate[i], flag_mix);
+        if (flag_insn > 0)
+            test_harness(test_insn, &candidate[i], flag_insn);
+        if (flag_kat > 0 && flag_jobs == 0)
             test_harness(test_kat, &candidate[i], flag_kat);
     }
+    harness_budget(0.0);
 
     // loop experiments until timeout, if timeout is specified
     while (flag_xprmt > 0) {
-        for (i = 0; i < ciphers; i++)
-            test_harness(test_xprmnt, &candidate[i], flag_xprmt);
+        if (flag_jobs > 0) {
+            tests[0].func = test_xprmnt;
+            tests[0].val = flag_xprmt;
+            harness_plan((double) ciphers /
+                (flag_jobs < ciphers ? flag_jobs : ciphers));
+            sched_run(candidate, ciphers, tests, 1, flag_jobs);
+        } else {
+            for (i = 0; i < ciphers; i++)
+                test_harness(test_xprmnt, &candidate[i], flag_xprmt);
+        }
         if (flag_timeout == 0)
             break;
     }
 
     // free up the dynamic libraries
-    for (i = 0; i < ciphers; i++)
-        dlclose(candidate[i].dlib);
+    for (i = 0; i < ciphers; i++) {
+        if (candidate[i].dlib != NULL)
+            dlclose(candidate[i].dlib);
+    }
     free(candidate);
 
     return 0;
@@ -0,0 +1,258 @@
+// mix.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Mixed packet size workload. Draws (mlen, adlen) pairs from a built-in
+// distribution or replays a trace file, reports packets/s and bytes/s.
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "brutus.h"
+
+// length of a generated packet sequence, timer check interval
+#define MIX_SEQ         4096
+#define MIX_CHECK       64
+
+typedef struct {
+    unsigned long long mlen, adlen;
+    int weight;
+} mix_pkt_t;
+
+// simple IMIX over IP packet sizes, 8 byte ESP-style header as AD
+static const mix_pkt_t mix_imix[] = {
+    { 40, 8, 7 }, { 576, 8, 4 }, { 1500, 8, 1 }, { 0, 0, 0 }
+};
+
+// TLS 1.3 records: handshake / alerts, interactive, MTU-sized, bulk;
+// the 5 byte record header is the AD
+static const mix_pkt_t mix_tls[] = {
+    { 32, 5, 2 }, { 256, 5, 2 }, { 1400, 5, 3 }, { 4096, 5, 1 },
+    { 16384, 5, 2 }, { 0, 0, 0 }
+};
+
+const char *brutus_mix = "imix";
+
+// expand a weighted table into a shuffled sequence. own LCG; don't
+// touch detseq so that later KATs are not affected.
+
+static int mix_table(const mix_pkt_t *tab, mix_pkt_t **seq)
+{
+    int i, j, n, w;
+    uint32_t r;
+    mix_pkt_t t, *s;
+
+    w = 0;
+    for (i = 0; tab[i].weight > 0; i++)
+        w += tab[i].weight;
+
+    if ((s = calloc(MIX_SEQ, sizeof(mix_pkt_t))) == NULL) {
+        perror("mix_table()");
+        return -1;
+    }
+    n = 0;
+    for (i = 0; tab[i].weight > 0; i++) {
+        for (j = 0; j < MIX_SEQ * tab[i].weight / w; j++)
+            s[n++] = tab[i];
+    }
+    r = 0x7A3C5E91;
+    for (i = n - 1; i > 0; i--) {
+        r = 1664525 * r + 1013904223;
+        j = (((uint64_t) r) * (i + 1)) >> 32;
+        t = s[i];
+        s[i] = s[j];
+        s[j] = t;
+    }
+    *seq = s;
+
+    return n;
+}
+
+// read a trace file: one "mlen [adlen]" per line, # starts a comment
+
+static int mix_trace(const char *fn, mix_pkt_t **seq)
+{
+    FILE *f;
+    char buf[256], *p, *ep;
+    int n, sz;
+    mix_pkt_t *s, *q;
+
+    if ((f = fopen(fn, "r")) == NULL) {
+        perror(fn);
+        return -1;
+    }
+
+    n = 0;
+    sz = 0;
+    s = NULL;
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        if ((p = strchr(buf, '#')) != NULL)
+            *p = 0;
+        for (p = buf; *p == ' ' || *p == '\t'; p++)
+            ;
+        if (*p == 0 || *p == '\n' || *p == '\r')
+            continue;
+
+        if (n >= sz) {
+            sz = sz > 0 ? 2 * sz : 256;
+            if ((q = realloc(s, sz * sizeof(mix_pkt_t))) == NULL) {
+                perror("mix_trace()");
+                n = -1;
+                break;
+            }
+            s = q;
+        }
+        s[n].mlen = strtoull(p, &ep, 0);
+        if (ep == p) {
+            fprintf(stderr, "%s: bad trace line: %s", fn, buf);
+            n = -1;
+            break;
+        }
+        p = ep;
+        s[n].adlen = strtoull(p, &ep, 0);
+        s[n].weight = 1;
+        n++;
+    }
+    fclose(f);
+
+    if (n <= 0) {
+        if (n == 0)
+            fprintf(stderr, "%s: empty trace\n", fn);
+        free(s);
+        return -1;
+    }
+    *seq = s;
+
+    return n;
+}
+
+int test_mix(caesar_t *aead, int limit)
+{
+    int ret, i, n;
+    unsigned long long maxm, maxa, am, aa, pkts, clen;
+    uint64_t tlim, stim, etim;
+    double bytes, tm, ta, sec, cyc, ns;
+    char json[160];
+    mix_pkt_t *seq;
+    arena_t ar;
+
+    if (strcmp(brutus_mix, "imix") == 0)
+        n = mix_table(mix_imix, &seq);
+    else if (strcmp(brutus_mix, "tls") == 0)
+        n = mix_table(mix_tls, &seq);
+    else
+        n = mix_trace(brutus_mix, &seq);
+    if (n <= 0)
+        return -1;
+
+    maxm = 0;
+    maxa = 0;
+    tm = 0.0;
+    ta = 0.0;
+    for (i = 0; i < n; i++) {
+        if (seq[i].mlen > maxm)
+            maxm = seq[i].mlen;
+        if (seq[i].adlen > maxa)
+            maxa = seq[i].adlen;
+        tm += (double) seq[i].mlen;
+        ta += (double) seq[i].adlen;
+    }
+
+    if (brutus_verbose) {
+        printf("[%s] Packet Mix (limit=%d sec, mix=%s, n=%d, "
+            "avg=%.1f+%.1f B)  key=%d  nsec=%d  npub=%d  a=%d\n",
+            aead->name, limit, brutus_mix, n, tm / n, ta / n,
+            aead->keybytes, aead->nsecbytes, aead->npubbytes, aead->abytes);
+    }
+
+    if (arena_alloc(&ar, aead, maxm, maxa) != 0) {
+        free(seq);
+        return -1;
+    }
+    detseq_fill(ar.key, aead->keybytes);
+    detseq_fill(ar.nsec, aead->nsecbytes);
+    detseq_fill(ar.npub, aead->npubbytes);
+    detseq_fill(ar.pt, maxm);
+    detseq_fill(ar.ad, maxa);
+
+    tlim = timer_ticks(limit);
+
+    // one pass to warm up, then cycle through the sequence
+    pkts = 0;
+    bytes = 0.0;
+    i = 0;
+    stim = 0;
+    etim = 0;
+    do {
+        clen = 0;
+        ret = aead->encrypt(ar.ct, &clen, ar.pt, seq[i].mlen,
+            ar.ad, seq[i].adlen, ar.nsec, ar.npub, ar.key);
+        if (ret != 0 || clen <= 0) {
+            fprintf(stderr, "!ERROR\t%s encrypt(%llu)=%d\n",
+                aead->name, seq[i].mlen, ret);
+            ret = -1;
+            goto done;
+        }
+        if (stim != 0) {
+            pkts++;
+            bytes += (double) (seq[i].mlen + seq[i].adlen);
+        }
+        if (++i >= n) {
+            i = 0;
+            if (stim == 0) {
+                stim = timer_start();
+                continue;
+            }
+        }
+        if (stim != 0 && (pkts % MIX_CHECK) == 0)
+            etim = timer_read() - stim;
+    } while (stim == 0 || etim < tlim);
+    etim = timer_stop() - stim;
+
+    sec = timer_sec(etim);
+    cyc = timer_cycles(etim);
+
+    if (fabs(timer_drift()) > TIMER_DRIFT_MAX) {
+        fprintf(stderr, "!FREQ\t%s core clock drifted %+.1f%% during mix\n",
+            aead->name, 100.0 * timer_drift());
+    }
+
+    // rows carry the average packet; JSON adds the cycle figures
+    am = (unsigned long long) (tm / n + 0.5);
+    aa = (unsigned long long) (ta / n + 0.5);
+    switch (brutus_format) {
+
+        case FORMAT_CSV:
+        case FORMAT_JSON:
+            snprintf(json, sizeof(json), ",\"cpb\":%.3f,\"cpc\":%.1f,"
+                "\"drift\":%.4f,\"mix\":\"%s\"",
+                bytes > 0.0 ? cyc / bytes : 0.0, cyc / ((double) pkts),
+                timer_drift(), brutus_mix);
+            speed_row(aead, timer_name(), "mix", am, aa, pkts, sec, NULL,
+                json);
+            break;
+
+        default:
+            printf("[%s] %.2f kB/s  %.0f pkt/s  encrypt(mix=%s)",
+                aead->name, bytes / sec / 1000.0, ((double) pkts) / sec,
+                brutus_mix);
+            if (cyc > 0.0) {
+                printf("  %.2f c/B  %.0f c/pkt", cyc / bytes,
+                    cyc / ((double) pkts));
+            }
+            printf("\n");
+            break;
+    }
+    fflush(stdout);
+    ns = 1E9 * sec / ((double) pkts);
+    results_record(aead, "mix", am, aa, 0, ns, ns, ns,
+        bytes / sec / 1000.0);
+    ret = 0;
+
+done:
+    free(seq);
+    arena_free(&ar);
+
+    return ret;
+}
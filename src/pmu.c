@@ -0,0 +1,152 @@
+// pmu.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Hardware performance counters for the speed loops. One perf_event
+// group so that all counters cover exactly the same interval; events
+// the CPU or kernel does not offer are simply left out.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "brutus.h"
+
+int brutus_pmu = 0;
+
+static int pmu_fd[PMU_EVENTS];          // -1 if not available
+static int pmu_slot[PMU_EVENTS];        // position in the group read
+static int pmu_nr = 0;                  // events in the group
+static int pmu_leader = -1;
+static pid_t pmu_pid = 0;               // process that owns the counters
+
+static const char *pmu_names[PMU_EVENTS] = {
+    "cycles", "instructions", "L1D-misses", "LLC-misses",
+    "branch-misses", "stalled-frontend", "stalled-backend"
+};
+
+#define PMU_CACHE(c, r) (PERF_COUNT_HW_CACHE_ ## c | \
+    (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+    (PERF_COUNT_HW_CACHE_RESULT_ ## r << 16))
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} pmu_events[PMU_EVENTS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PMU_CACHE(L1D, MISS) },
+    { PERF_TYPE_HW_CACHE, PMU_CACHE(LL, MISS) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND }
+};
+
+static int pmu_open(int ev, int group)
+{
+    struct perf_event_attr pe;
+
+    memset(&pe, 0, sizeof(pe));
+    pe.size = sizeof(pe);
+    pe.type = pmu_events[ev].type;
+    pe.config = pmu_events[ev].config;
+    pe.disabled = group < 0 ? 1 : 0;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    pe.read_format = PERF_FORMAT_GROUP |
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return syscall(SYS_perf_event_open, &pe, 0, -1, group, 0);
+}
+
+// (re)open the group in this process. counters only follow the thread
+// that opened them, and tests run in a forked child.
+
+static void pmu_group()
+{
+    int i;
+
+    if (pmu_pid != 0) {
+        for (i = 0; i < PMU_EVENTS; i++) {
+            if (pmu_fd[i] >= 0)
+                close(pmu_fd[i]);
+        }
+    }
+    pmu_pid = getpid();
+    pmu_nr = 0;
+    pmu_leader = -1;
+    for (i = 0; i < PMU_EVENTS; i++) {
+        pmu_fd[i] = pmu_open(i, pmu_leader);
+        pmu_slot[i] = -1;
+        if (pmu_fd[i] < 0)
+            continue;
+        if (pmu_leader < 0)
+            pmu_leader = pmu_fd[i];
+        pmu_slot[i] = pmu_nr++;
+    }
+}
+
+// open the counter group. returns the number of usable counters,
+// 0 if there are none (no PMU, virtual machine, perf_event_paranoid).
+
+int pmu_init()
+{
+    int i;
+
+    pmu_group();
+
+    if (brutus_verbose && pmu_nr > 0) {
+        printf("\tpmu=");
+        for (i = 0; i < PMU_EVENTS; i++) {
+            if (pmu_fd[i] >= 0)
+                printf("%s%s", pmu_names[i], pmu_slot[i] < pmu_nr - 1 ?
+                    "," : "\n");
+        }
+        fflush(stdout);
+    }
+
+    return pmu_nr;
+}
+
+void pmu_start()
+{
+    if (pmu_pid != 0 && pmu_pid != getpid())
+        pmu_group();
+    if (pmu_leader < 0)
+        return;
+    ioctl(pmu_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(pmu_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// stop and read counts into cnt[PMU_EVENTS], scaled up if the group was
+// multiplexed. missing events are set to -1. returns 0 on success.
+
+int pmu_stop(double *cnt)
+{
+    int i;
+    uint64_t buf[3 + PMU_EVENTS];
+    double f;
+
+    for (i = 0; i < PMU_EVENTS; i++)
+        cnt[i] = -1.0;
+    if (pmu_leader < 0)
+        return -1;
+
+    ioctl(pmu_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (read(pmu_leader, buf, sizeof(buf)) < (ssize_t)
+        ((3 + pmu_nr) * sizeof(uint64_t)))
+        return -1;
+
+    // buf = { nr, time_enabled, time_running, values.. }
+    if (buf[2] == 0)
+        return -1;
+    f = ((double) buf[1]) / ((double) buf[2]);
+    for (i = 0; i < PMU_EVENTS; i++) {
+        if (pmu_slot[i] >= 0)
+            cnt[i] = f * ((double) buf[3 + pmu_slot[i]]);
+    }
+
+    return 0;
+}
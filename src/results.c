@@ -0,0 +1,221 @@
+// results.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Results store and baseline comparison. Speed records are appended to
+// a tab-separated file keyed by CPU model, compiler, cipher and
+// implementation; a baseline file from an earlier run can be loaded and
+// every new record is compared against the latest matching one.
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "brutus.h"
+
+// record format version tag, first field of every line
+#define RESULTS_TAG     "brutus1"
+
+typedef struct {
+    char *cpu, *cc, *name, *op;
+    unsigned long long mlen, adlen;
+    int n;
+    double med, lo, hi;                 // ns per call
+} results_rec_t;
+
+const char *brutus_db = NULL;
+
+static char results_cpu[128] = "unknown";
+static char results_cc[256] = "unknown";
+static results_rec_t *results_base = NULL;
+static int results_nbase = 0;
+
+// strip newline and turn tabs into spaces
+
+static void results_clean(char *s)
+{
+    for (; *s != 0; s++) {
+        if (*s == '\t')
+            *s = ' ';
+        if (*s == '\n' || *s == '\r')
+            *s = 0;
+    }
+}
+
+// host CPU model and compiler line + version
+
+void results_init()
+{
+    FILE *f;
+    char buf[256], *p;
+
+    if ((f = fopen("/proc/cpuinfo", "r")) != NULL) {
+        while (fgets(buf, sizeof(buf), f) != NULL) {
+            if (strncmp(buf, "model name", 10) == 0 &&
+                (p = strchr(buf, ':')) != NULL) {
+                for (p++; *p == ' '; p++)
+                    ;
+                snprintf(results_cpu, sizeof(results_cpu), "%s", p);
+                break;
+            }
+        }
+        fclose(f);
+    }
+    results_clean(results_cpu);
+
+    if ((f = fopen("brutus_cc.cfg", "r")) == NULL)
+        return;
+    if (fgets(buf, sizeof(buf), f) != NULL) {
+        results_clean(buf);
+        snprintf(results_cc, sizeof(results_cc), "%s", buf);
+    }
+    fclose(f);
+
+    // compiler version, first line of "cc --version"
+    if ((p = strchr(buf, ' ')) != NULL)
+        *p = 0;
+    if (strlen(buf) + 32 > sizeof(buf))
+        return;
+    strcat(buf, " --version 2>/dev/null");
+    if ((f = popen(buf, "r")) == NULL)
+        return;
+    if (fgets(buf, sizeof(buf), f) != NULL) {
+        results_clean(buf);
+        p = results_cc + strlen(results_cc);
+        snprintf(p, sizeof(results_cc) - (p - results_cc), " (%s)", buf);
+    }
+    pclose(f);
+}
+
+// load a baseline file. returns the number of records or -1.
+
+int results_load(const char *fn)
+{
+    FILE *f;
+    char buf[1024], *fld[15], *p;
+    int i;
+    results_rec_t *r, *q;
+
+    if ((f = fopen(fn, "r")) == NULL) {
+        perror(fn);
+        return -1;
+    }
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        buf[strcspn(buf, "\r\n")] = 0;
+        // split into fields; tabs were removed from values on writing
+        p = buf;
+        for (i = 0; i < 15 && p != NULL; i++) {
+            fld[i] = p;
+            if ((p = strchr(p, '\t')) != NULL)
+                *p++ = 0;
+        }
+        if (i < 15 || strcmp(fld[0], RESULTS_TAG) != 0)
+            continue;
+
+        q = realloc(results_base, (results_nbase + 1) * sizeof(*q));
+        if (q == NULL) {
+            perror("results_load()");
+            break;
+        }
+        results_base = q;
+        r = &results_base[results_nbase++];
+        r->cpu = strdup(fld[2]);
+        r->cc = strdup(fld[3]);
+        r->name = strdup(fld[4]);
+        r->op = strdup(fld[5]);
+        r->mlen = strtoull(fld[6], NULL, 10);
+        r->adlen = strtoull(fld[7], NULL, 10);
+        r->n = atoi(fld[9]);
+        r->med = atof(fld[10]);
+        r->lo = atof(fld[11]);
+        r->hi = atof(fld[12]);
+    }
+    fclose(f);
+
+    return results_nbase;
+}
+
+// compare against the latest baseline record on the same CPU model
+
+static void results_compare(caesar_t *aead, const char *op,
+                        unsigned long long mlen, unsigned long long adlen,
+                        int n, double med, double lo, double hi)
+{
+    int i, sig;
+    double rel;
+    results_rec_t *r;
+
+    r = NULL;
+    for (i = 0; i < results_nbase; i++) {
+        if (results_base[i].mlen == mlen && results_base[i].adlen == adlen &&
+            strcmp(results_base[i].name, aead->name) == 0 &&
+            strcmp(results_base[i].op, op) == 0 &&
+            strcmp(results_base[i].cpu, results_cpu) == 0)
+            r = &results_base[i];
+    }
+    if (r == NULL || r->med <= 0.0)
+        return;
+
+    // significant: confidence intervals of the medians do not overlap
+    // and the change is large enough to matter; without repetitions
+    // only large changes count
+    rel = med / r->med - 1.0;
+    if (n > 0 && r->n > 0)
+        sig = lo > r->hi && rel > RESULTS_SLOW;
+    else
+        sig = rel > RESULTS_NOISE;
+
+    if (brutus_verbose) {
+        printf("[%s] %s(mlen=%llu adlen=%llu) %.1f ns  baseline %.1f ns  "
+            "%+.1f%%%s\n", aead->name, op, mlen, adlen, med, r->med,
+            100.0 * rel, sig ? " *" : "");
+    }
+    if (sig) {
+        fprintf(stderr, "!REGRESS\t%s %s(mlen=%llu adlen=%llu) %+.1f%% "
+            "(%.1f ns [%.1f, %.1f] vs %.1f ns [%.1f, %.1f])\n",
+            aead->name, op, mlen, adlen, 100.0 * rel,
+            med, lo, hi, r->med, r->lo, r->hi);
+    }
+}
+
+// store and / or compare one speed record. times are ns per call;
+// n is the number of repetitions (0 = single run, lo = hi = med).
+
+void results_record(caesar_t *aead, const char *op,
+                    unsigned long long mlen, unsigned long long adlen,
+                    int n, double med, double lo, double hi, double kbps)
+{
+    int fd, pfx, len;
+    char buf[1024], tstr[32];
+    time_t t;
+
+    if (results_nbase > 0 && strcmp(op, "timeout") != 0)
+        results_compare(aead, op, mlen, adlen, n, med, lo, hi);
+
+    if (brutus_db == NULL)
+        return;
+
+    t = time(NULL);
+    strftime(tstr, sizeof(tstr), "%Y-%m-%dT%H:%M:%S", gmtime(&t));
+    pfx = name_prefix(aead->name);
+
+    // one write() per line so that parallel writers don't interleave
+    len = snprintf(buf, sizeof(buf),
+        "%s\t%s\t%s\t%s\t%s\t%s\t%llu\t%llu\t%s\t%d\t%.2f\t%.2f\t%.2f\t"
+        "%.2f\t%.*s\n", RESULTS_TAG, tstr, results_cpu, results_cc,
+        aead->name, op, mlen, adlen, timer_name(), n, med, lo, hi, kbps,
+        pfx, aead->name);
+    if (len <= 0 || len >= (int) sizeof(buf))
+        return;
+
+    if ((fd = open(brutus_db, O_WRONLY | O_APPEND | O_CREAT, 0644)) < 0) {
+        perror(brutus_db);
+        return;
+    }
+    if (write(fd, buf, len) != len)
+        perror(brutus_db);
+    close(fd);
+}
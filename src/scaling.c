@@ -0,0 +1,265 @@
+// scaling.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Multi-threaded throughput scaling. Every thread has its own key, nonce
+// and buffers; outputs are checked against a single-threaded reference
+// to catch hidden shared state.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "brutus.h"
+
+// compare against reference every this many calls (power of two)
+#ifndef SCALING_CHECK
+#define SCALING_CHECK 16
+#endif
+
+typedef struct {
+    caesar_t *aead;
+    pthread_t tid;
+    int cpu, pinned;
+    arena_t ar;                 // reference output goes to ar.xt
+    unsigned long long mlen, adlen, rlen, calls, diverged;
+    int err;
+} scaling_thr_t;
+
+// start gate: threads check in when pinned and wait for go
+static pthread_mutex_t scaling_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scaling_cv = PTHREAD_COND_INITIALIZER;
+static int scaling_ready, scaling_go;
+static volatile int scaling_stop;
+
+// wall clock; clock() would sum up the cpu time of all threads
+
+static double scaling_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((double) ts.tv_sec) + 1E-9 * ((double) ts.tv_nsec);
+}
+
+static void *scaling_worker(void *arg)
+{
+    scaling_thr_t *th = (scaling_thr_t *) arg;
+    caesar_t *aead = th->aead;
+    unsigned long long clen;
+    cpu_set_t cs;
+
+    CPU_ZERO(&cs);
+    CPU_SET(th->cpu, &cs);
+    th->pinned = pthread_setaffinity_np(pthread_self(),
+        sizeof(cs), &cs) == 0;
+
+    pthread_mutex_lock(&scaling_mtx);
+    scaling_ready++;
+    pthread_cond_broadcast(&scaling_cv);
+    while (!scaling_go)
+        pthread_cond_wait(&scaling_cv, &scaling_mtx);
+    pthread_mutex_unlock(&scaling_mtx);
+
+    while (!scaling_stop) {
+        clen = 0;
+        if (aead->encrypt(th->ar.ct, &clen, th->ar.pt, th->mlen,
+            th->ar.ad, th->adlen, th->ar.nsec, th->ar.npub,
+            th->ar.key) != 0) {
+            th->err++;
+            break;
+        }
+        if ((th->calls & (SCALING_CHECK - 1)) == 0 &&
+            (clen != th->rlen || memcmp(th->ar.ct, th->ar.xt, clen) != 0))
+            th->diverged++;
+        th->calls++;
+    }
+
+    return NULL;
+}
+
+// run nthr threads for limit seconds. returns the elapsed seconds, or
+// a negative value if the threads could not be started.
+
+static double scaling_run(caesar_t *aead, scaling_thr_t *th, int nthr,
+                        int limit, unsigned long long *calls,
+                        unsigned long long *diverged)
+{
+    int i, n, pin;
+    double t0, t1;
+    struct timespec ts;
+
+    scaling_stop = 0;
+    scaling_ready = 0;
+    scaling_go = 0;
+    for (n = 0; n < nthr; n++) {
+        th[n].calls = 0;
+        th[n].diverged = 0;
+        th[n].err = 0;
+        if (pthread_create(&th[n].tid, NULL, scaling_worker, &th[n]) != 0) {
+            perror("pthread_create()");
+            break;
+        }
+    }
+
+    // release the threads that started; stop at once if not all did
+    pthread_mutex_lock(&scaling_mtx);
+    while (scaling_ready < n)
+        pthread_cond_wait(&scaling_cv, &scaling_mtx);
+    scaling_stop = n < nthr;
+    scaling_go = 1;
+    pthread_cond_broadcast(&scaling_cv);
+    pthread_mutex_unlock(&scaling_mtx);
+    if (n < nthr) {
+        for (i = 0; i < n; i++)
+            pthread_join(th[i].tid, NULL);
+        return -1.0;
+    }
+    t0 = scaling_now();
+
+    ts.tv_sec = limit;
+    ts.tv_nsec = 0;
+    nanosleep(&ts, NULL);
+    scaling_stop = 1;
+
+    *calls = 0;
+    *diverged = 0;
+    pin = 0;
+    for (i = 0; i < nthr; i++) {
+        pthread_join(th[i].tid, NULL);
+        *calls += th[i].calls;
+        *diverged += th[i].diverged + th[i].err;
+        pin += th[i].pinned;
+    }
+    t1 = scaling_now();
+
+    if (pin < nthr) {
+        fprintf(stderr, "!WARN\t%s %d of %d threads could not be pinned; "
+            "speedup unreliable\n", aead->name, nthr - pin, nthr);
+    }
+
+    return t1 - t0;
+}
+
+// thread scaling test up to brutus_threads threads
+
+int test_scaling(caesar_t *aead, int limit)
+{
+    int i, nthr, ncpu, ret, cpu[CPU_SETSIZE];
+    unsigned long long mlen, adlen, clen, div, calls;
+    double sec, spd, spd1;
+    char op[32], json[80];
+    cpu_set_t cs;
+    scaling_thr_t *th;
+
+    mlen = brutus_mlens.n > 0 ? brutus_mlens.len[0] : 0x10000;
+    adlen = brutus_adlens.n > 0 ? brutus_adlens.len[0] : 0;
+
+    // the cpus this process may run on (taskset, cpusets)
+    ncpu = 0;
+    if (sched_getaffinity(0, sizeof(cs), &cs) == 0) {
+        for (i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &cs))
+                cpu[ncpu++] = i;
+        }
+    }
+    if (ncpu < 1) {
+        perror("sched_getaffinity()");
+        cpu[0] = 0;
+        ncpu = 1;
+    }
+
+    if (brutus_verbose) {
+        printf("[%s] Thread Scaling (limit=%d sec, threads=%d, cpus=%d)  "
+            "key=%d  nsec=%d  npub=%d  a=%d\n",
+            aead->name, limit, brutus_threads, ncpu, aead->keybytes,
+            aead->nsecbytes, aead->npubbytes, aead->abytes);
+    }
+
+    if ((th = calloc(brutus_threads, sizeof(scaling_thr_t))) == NULL) {
+        perror("test_scaling()");
+        return -1;
+    }
+
+    // private inputs and single-threaded reference output for each thread
+    ret = 0;
+    for (i = 0; i < brutus_threads; i++) {
+        th[i].aead = aead;
+        th[i].cpu = cpu[i % ncpu];
+        th[i].mlen = mlen;
+        th[i].adlen = adlen;
+        // xt must hold a full ciphertext
+        if (arena_alloc(&th[i].ar, aead, mlen + aead->abytes, adlen) != 0) {
+            ret = -1;
+            goto done;
+        }
+        detseq_fill(th[i].ar.key, aead->keybytes);
+        detseq_fill(th[i].ar.nsec, aead->nsecbytes);
+        detseq_fill(th[i].ar.npub, aead->npubbytes);
+        detseq_fill(th[i].ar.pt, mlen);
+        detseq_fill(th[i].ar.ad, adlen);
+
+        clen = 0;
+        if (aead->encrypt(th[i].ar.xt, &clen, th[i].ar.pt, mlen,
+            th[i].ar.ad, adlen, th[i].ar.nsec, th[i].ar.npub,
+            th[i].ar.key) != 0) {
+            fprintf(stderr, "!ERROR\t%s encrypt(%llu) failed\n",
+                aead->name, mlen);
+            ret = -1;
+            goto done;
+        }
+        th[i].rlen = clen;
+    }
+
+    // 1, 2, 4, .. brutus_threads
+    spd1 = 0.0;
+    for (nthr = 1; ; nthr = nthr * 2 < brutus_threads ?
+        nthr * 2 : brutus_threads) {
+
+        sec = scaling_run(aead, th, nthr, limit, &calls, &div);
+        if (sec < 0.0) {
+            ret = -1;
+            break;
+        }
+        spd = ((double) calls) * ((double) (mlen + adlen)) / sec;
+        if (nthr == 1)
+            spd1 = spd;
+
+        // threads are part of the op name so that CSV rows are distinct
+        if (brutus_format == FORMAT_TEXT) {
+            printf("[%s] %.2f kB/s  threads=%d  speedup=%.2f  eff=%.1f%%  "
+                "encrypt(mlen=%llu adlen=%llu)\n", aead->name,
+                spd / 1000.0, nthr, spd / spd1,
+                100.0 * spd / (spd1 * nthr), mlen, adlen);
+        } else {
+            snprintf(op, sizeof(op), "scaling-%d", nthr);
+            snprintf(json, sizeof(json), ",\"threads\":%d,"
+                "\"speedup\":%.3f,\"eff\":%.4f", nthr, spd / spd1,
+                spd / (spd1 * nthr));
+            speed_row(aead, "wall", op, mlen, adlen, calls, sec, NULL,
+                json);
+        }
+        if (div > 0) {
+            fprintf(stderr, "!SHARED\t%s %llu diverging outputs with %d "
+                "threads\n", aead->name, div, nthr);
+            ret = -2;
+        }
+        fflush(stdout);
+
+        if (nthr >= brutus_threads)
+            break;
+    }
+
+done:
+    for (i = 0; i < brutus_threads; i++)
+        arena_free(&th[i].ar);
+    free(th);
+
+    return ret;
+}
@@ -0,0 +1,453 @@
+// sched.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Parallel job scheduler. A pool of N long-lived worker processes, forked
+// once with all candidates loaded, runs (candidate, test) jobs received
+// over a pipe in-process and streams back the output of each job. Worker
+// w owns the candidates c with c % N = w and runs all of their jobs, so
+// a candidate's state stays in one process. A worker that dies, overruns
+// its time limit (-T) by SCHED_GRACE, or has unwound a fault or timeout
+// in-process, is replaced by one forked with the candidate marked as
+// crashed. Output is printed in candidate order; results that arrive
+// ahead of their turn wait in a spool file, not in memory.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "brutus.h"
+
+typedef struct {
+    pid_t pid;          // worker process, 0 if not running
+    int job;            // job in progress, -1 if idle
+    int next;           // next job of its candidates, njobs if none
+    int cmd, res;       // job pipe (write end), result pipe (read end)
+    double start, end;  // job started, kill the worker after end (0 = no)
+} sched_worker_t;
+
+typedef struct {
+    int state;          // SCHED_WAIT, SCHED_RUN or SCHED_DONE
+    off_t out, err;     // stdout and stderr in the spool file
+    size_t outlen, errlen;
+} sched_job_t;
+
+#define SCHED_WAIT      0
+#define SCHED_RUN       1
+#define SCHED_DONE      2
+
+// the worker's own watchdog gets this many secs before it is killed
+#define SCHED_GRACE     1.0
+
+// job request: job number and time budget (0 = none)
+typedef struct {
+    int job;
+    double budget;
+} sched_cmd_t;
+
+// result frame: header followed by outlen + errlen bytes. quit is set
+// when the worker exits after it; its candidate has crashed.
+typedef struct {
+    int job, ret, quit;
+    size_t outlen, errlen;
+} sched_msg_t;
+
+// full read / write on a pipe
+
+static int sched_read(int fd, void *buf, size_t len)
+{
+    ssize_t n;
+    size_t i;
+
+    for (i = 0; i < len; i += n) {
+        n = read(fd, ((char *) buf) + i, len - i);
+        if (n <= 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static int sched_write(int fd, const void *buf, size_t len)
+{
+    ssize_t n;
+    size_t i;
+
+    for (i = 0; i < len; i += n) {
+        n = write(fd, ((const char *) buf) + i, len - i);
+        if (n <= 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+// send the contents of a captured stream and empty it
+
+static int sched_send(int fd, int res, size_t len)
+{
+    char buf[0x1000];
+    size_t i;
+    ssize_t n;
+
+    for (i = 0; i < len; i += n) {
+        n = pread(fd, buf, len - i < sizeof(buf) ? len - i : sizeof(buf), i);
+        if (n <= 0 || sched_write(res, buf, n) != 0)
+            return -1;
+    }
+    if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0)
+        return -1;
+
+    return 0;
+}
+
+// copy len bytes from the pipe to the spool file at *end
+
+static int sched_spool(int res, int spool, off_t *end, size_t len)
+{
+    char buf[0x1000];
+    size_t i, n;
+
+    for (i = 0; i < len; i += n) {
+        n = len - i < sizeof(buf) ? len - i : sizeof(buf);
+        if (sched_read(res, buf, n) != 0 ||
+            pwrite(spool, buf, n, *end) != (ssize_t) n)
+            return -1;
+        *end += n;
+    }
+
+    return 0;
+}
+
+// print len bytes of the spool file from off
+
+static void sched_print(int spool, off_t off, size_t len, FILE *f)
+{
+    char buf[0x1000];
+    size_t i;
+    ssize_t n;
+
+    for (i = 0; i < len; i += n) {
+        n = pread(spool, buf, len - i < sizeof(buf) ? len - i : sizeof(buf),
+            off + i);
+        if (n <= 0)
+            break;
+        fwrite(buf, 1, n, f);
+    }
+}
+
+// worker: run jobs until the job pipe is closed
+
+static void sched_worker(caesar_t *cand, sched_test_t *test, int ntests,
+                        int cmd, int res)
+{
+    int j;
+    FILE *out, *err;
+    sched_cmd_t req;
+    sched_msg_t msg;
+
+    out = tmpfile();
+    err = tmpfile();
+    if (out == NULL || err == NULL)
+        _exit(1);
+    dup2(fileno(out), STDOUT_FILENO);
+    dup2(fileno(err), STDERR_FILENO);
+
+    // faults are caught in-process; crashed candidates fork per test.
+    // the parent kills a worker that hangs after unwinding.
+    brutus_inproc = 1;
+    brutus_watched = 1;
+
+    while (sched_read(cmd, &req, sizeof(req)) == 0) {
+        j = req.job;
+        harness_budget(req.budget);
+        msg.job = j;
+        msg.quit = cand[j / ntests].crashed;
+        msg.ret = test_harness(test[j % ntests].func, &cand[j / ntests],
+            test[j % ntests].val);
+        // the process state may be corrupt after siglongjmp
+        msg.quit = !msg.quit && cand[j / ntests].crashed;
+        fflush(stdout);
+        fflush(stderr);
+        msg.outlen = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+        msg.errlen = lseek(STDERR_FILENO, 0, SEEK_CUR);
+        if (sched_write(res, &msg, sizeof(msg)) != 0 ||
+            sched_send(STDOUT_FILENO, res, msg.outlen) != 0 ||
+            sched_send(STDERR_FILENO, res, msg.errlen) != 0 || msg.quit)
+            break;
+    }
+    _exit(0);
+}
+
+// start (or restart) worker w
+
+static int sched_spawn(sched_worker_t *wrk, int jobs, int w,
+                        caesar_t *cand, sched_test_t *test, int ntests)
+{
+    int i, cmd[2], res[2];
+    pid_t p;
+
+    if (pipe(cmd) != 0 || pipe(res) != 0) {
+        perror("pipe()");
+        return -1;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    p = fork();
+    if (p == 0) {
+        // other workers' pipes must not be held open here
+        for (i = 0; i < jobs; i++) {
+            if (wrk[i].pid > 0) {
+                close(wrk[i].cmd);
+                close(wrk[i].res);
+            }
+        }
+        close(cmd[1]);
+        close(res[0]);
+        sched_worker(cand, test, ntests, cmd[0], res[1]);
+    }
+    close(cmd[0]);
+    close(res[1]);
+    if (p < 0) {
+        perror("fork()");
+        close(cmd[1]);
+        close(res[0]);
+        return -1;
+    }
+    wrk[w].pid = p;
+    wrk[w].job = -1;
+    wrk[w].cmd = cmd[1];
+    wrk[w].res = res[0];
+
+    return 0;
+}
+
+// stop worker w; its job, if any, has failed and its candidate is run
+// in a child process from then on
+
+static void sched_reap(sched_worker_t *wrk, int w, sched_job_t *job,
+                        caesar_t *cand, int ntests, int spool, off_t *end,
+                        const char *msg)
+{
+    int stat;
+    size_t len;
+    sched_job_t *jb;
+
+    close(wrk[w].cmd);
+    close(wrk[w].res);
+    waitpid(wrk[w].pid, &stat, 0);
+    wrk[w].pid = 0;
+
+    if (wrk[w].job >= 0) {
+        // output received before the failure, if any, is dropped
+        jb = &job[wrk[w].job];
+        len = strlen(msg);
+        jb->out = *end;
+        jb->outlen = pwrite(spool, msg, len, *end) == (ssize_t) len ?
+            len : 0;
+        *end += jb->outlen;
+        jb->err = *end;
+        jb->errlen = 0;
+        jb->state = SCHED_DONE;
+        cand[wrk[w].job / ntests].crashed = 1;
+        wrk[w].job = -1;
+    }
+}
+
+// receive a result frame from worker w
+
+static int sched_recv(sched_worker_t *wrk, int w, sched_job_t *job,
+                        int njobs, caesar_t *cand, int ntests,
+                        int spool, off_t *end)
+{
+    sched_msg_t msg;
+    sched_job_t *jb;
+
+    if (sched_read(wrk[w].res, &msg, sizeof(msg)) != 0 ||
+        msg.job != wrk[w].job || msg.job < 0 || msg.job >= njobs)
+        return -1;
+
+    jb = &job[msg.job];
+    jb->out = *end;
+    if (sched_spool(wrk[w].res, spool, end, msg.outlen) != 0)
+        return -1;
+    jb->outlen = msg.outlen;
+    jb->err = *end;
+    if (sched_spool(wrk[w].res, spool, end, msg.errlen) != 0)
+        return -1;
+    jb->errlen = msg.errlen;
+    jb->state = SCHED_DONE;
+    wrk[w].job = -1;
+
+    // the worker exits; isolate the candidate in its successors too
+    if (msg.quit) {
+        cand[msg.job / ntests].crashed = 1;
+        sched_reap(wrk, w, job, cand, ntests, spool, end, NULL);
+    }
+
+    return 0;
+}
+
+// run ntests tests on each of the ciphers candidates using jobs workers
+
+int sched_run(caesar_t *cand, int ciphers, sched_test_t *test, int ntests,
+            int jobs)
+{
+    int i, j, w, n, done, njobs, tmo, spool;
+    off_t end;
+    double t, lim;
+    FILE *spf;
+    sched_cmd_t req;
+    sched_worker_t *wrk;
+    sched_job_t *job;
+    struct pollfd *pfd;
+
+    if (ciphers <= 0 || ntests <= 0)
+        return 0;
+    if (jobs < 1)
+        jobs = 1;
+
+    // one job per candidate and test, candidate-major
+    njobs = ciphers * ntests;
+    if (jobs > ciphers)
+        jobs = ciphers;
+    job = calloc(njobs, sizeof(sched_job_t));
+    wrk = calloc(jobs, sizeof(sched_worker_t));
+    pfd = calloc(jobs, sizeof(struct pollfd));
+    if (job == NULL || wrk == NULL || pfd == NULL) {
+        perror("sched_run()");
+        exit(-1);
+    }
+    if ((spf = tmpfile()) == NULL) {
+        perror("tmpfile()");
+        exit(-1);
+    }
+    spool = fileno(spf);
+    end = 0;
+
+    for (w = 0; w < jobs; w++) {
+        wrk[w].next = w * ntests;
+        if (sched_spawn(wrk, jobs, w, cand, test, ntests) != 0)
+            exit(-1);
+    }
+
+    done = 0;           // next candidate to print
+
+    while (done < ciphers) {
+
+        // hand out jobs to idle workers, replacing dead ones
+        for (w = 0; w < jobs; w++) {
+            if (wrk[w].pid == 0 &&
+                sched_spawn(wrk, jobs, w, cand, test, ntests) != 0)
+                exit(-1);
+            if (wrk[w].job < 0 && wrk[w].next < njobs) {
+                // its next job; after the last test of a candidate skip
+                // to the worker's next candidate
+                j = wrk[w].next++;
+                if (wrk[w].next % ntests == 0)
+                    wrk[w].next += (jobs - 1) * ntests;
+                // one unit of the run's plan (-t); the job takes 1 / jobs
+                // of the wall time
+                req.job = j;
+                req.budget = harness_unit();
+                harness_spend(1.0 / jobs);
+                lim = brutus_tlimit;
+                if (req.budget > 0.0 && (lim <= 0.0 || req.budget < lim))
+                    lim = req.budget;
+                wrk[w].job = j;
+                wrk[w].start = harness_now();
+                wrk[w].end = lim > 0.0 ? wrk[w].start + lim + SCHED_GRACE :
+                    0.0;
+                job[j].state = SCHED_RUN;
+                if (sched_write(wrk[w].cmd, &req, sizeof(req)) != 0)
+                    sched_reap(wrk, w, job, cand, ntests, spool, &end,
+                        "\n[WORKER FAILED]\n");
+            }
+        }
+
+        // wait for results until the first worker deadline
+        n = 0;
+        tmo = -1;
+        t = harness_now();
+        for (w = 0; w < jobs; w++) {
+            pfd[w].fd = wrk[w].job >= 0 ? wrk[w].res : -1;
+            pfd[w].events = POLLIN;
+            pfd[w].revents = 0;
+            if (wrk[w].job < 0)
+                continue;
+            n++;
+            if (wrk[w].end > 0.0) {
+                i = wrk[w].end > t ? (int) (1000.0 * (wrk[w].end - t)) + 1 : 0;
+                if (tmo < 0 || i < tmo)
+                    tmo = i;
+            }
+        }
+        if (n > 0 && poll(pfd, jobs, tmo) < 0) {
+            perror("poll()");
+            break;
+        }
+        t = harness_now();
+        for (w = 0; w < jobs; w++) {
+            if (pfd[w].fd >= 0 && pfd[w].revents != 0) {
+                if (sched_recv(wrk, w, job, njobs, cand, ntests,
+                    spool, &end) != 0)
+                    sched_reap(wrk, w, job, cand, ntests, spool, &end,
+                        "\n[WORKER FAILED]\n");
+            } else if (wrk[w].job >= 0 && wrk[w].end > 0.0 &&
+                t >= wrk[w].end) {
+                // hung beyond the reach of its own watchdog
+                fprintf(stderr, "!TIMEOUT\t%s worker killed after %.2f "
+                    "sec\n", cand[wrk[w].job / ntests].name,
+                    t - wrk[w].start);
+                kill(wrk[w].pid, SIGKILL);
+                sched_reap(wrk, w, job, cand, ntests, spool, &end,
+                    "\n[TIMEOUT]\n");
+            }
+        }
+
+        // print finished candidates in order
+        while (done < ciphers) {
+            for (i = 0; i < ntests; i++) {
+                if (job[done * ntests + i].state != SCHED_DONE)
+                    break;
+            }
+            if (i < ntests)
+                break;
+            for (i = 0; i < ntests; i++)
+                sched_print(spool, job[done * ntests + i].out,
+                    job[done * ntests + i].outlen, stdout);
+            fflush(stdout);
+            for (i = 0; i < ntests; i++)
+                sched_print(spool, job[done * ntests + i].err,
+                    job[done * ntests + i].errlen, stderr);
+            fflush(stderr);
+            done++;
+
+            // start the spool over when nothing in it is waiting
+            for (i = done * ntests; i < njobs; i++) {
+                if (job[i].state == SCHED_DONE)
+                    break;
+            }
+            if (i >= njobs && ftruncate(spool, 0) == 0)
+                end = 0;
+        }
+    }
+
+    // closing the job pipe stops a worker
+    for (w = 0; w < jobs; w++) {
+        if (wrk[w].pid > 0) {
+            wrk[w].job = -1;
+            sched_reap(wrk, w, job, cand, ntests, spool, &end, NULL);
+        }
+    }
+    fclose(spf);
+    free(pfd);
+    free(wrk);
+    free(job);
+
+    return 0;
+}
@@ -9,90 +9,807 @@
 
 #include "brutus.h"
 
+// speed test state
+
+typedef struct {
+    caesar_t *aead;
+    uint8_t *key, *nsec, *osec, *npub, *pt, *ad, *ct;
+    unsigned long long mlen, adlen, clen;
+    double pmu[PMU_EVENTS];             // counters of the last run, or -1
+    unsigned long long pmu_calls;       // calls covered by the counters
+    const char *op;                     // record name if not the operation
+} speed_ctx_t;
+
+// operations
+
+#define SPEED_ENC       0
+#define SPEED_DEC       1
+#define SPEED_ENCDEC    2
+
+static const char *speed_opname[3] = { "encrypt", "decrypt", "enc+dec" };
+
+// call encrypt, decrypt or encrypt followed by decrypt n times
+
+static int speed_calls(speed_ctx_t *sc, int op, unsigned long long n)
+{
+    int ret;
+    unsigned long long i, t;
+    caesar_t *aead = sc->aead;
+
+    for (i = 0; i < n; i++) {
+        if (op != SPEED_DEC) {
+            sc->clen = 0;
+            ret = aead->encrypt(sc->ct, &sc->clen, sc->pt, sc->mlen,
+                sc->ad, sc->adlen, sc->nsec, sc->npub, sc->key);
+            if (ret != 0 || sc->clen <= 0) {
+                fprintf(stderr, "!ERROR\t%s encrypt(%llu)=%d\n",
+                    aead->name, sc->mlen, ret);
+                return -1;
+            }
+        }
+        if (op != SPEED_ENC) {
+            ret = aead->decrypt(sc->pt, &t, sc->osec, sc->ct, sc->clen,
+                sc->ad, sc->adlen, sc->npub, sc->key);
+            if (ret != 0) {
+                fprintf(stderr, "!ERROR\t%s decrypt(%llu)=%d\n",
+                    aead->name, sc->clen, ret);
+                return -2;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// CSV column names; JSON uses the same keys
+
+static const char *speed_fields =
+    "cipher,impl,key,nsec,npub,abytes,timer,op,mlen,adlen,calls,sec,"
+    "kBps,calls_per_sec,cpb,cpc,drift,n,kept,unit,min,med,p90,ci_lo,ci_hi";
+
+// extra columns with hardware counters (-P)
+
+static const char *speed_pmu_fields =
+    "ipc,l1d_pb,llc_pb,brmiss_pc,stall_fe,stall_be";
+
+void speed_header()
+{
+    if (brutus_format == FORMAT_CSV) {
+        printf("%s%s%s\n", speed_fields, brutus_pmu ? "," : "",
+            brutus_pmu ? speed_pmu_fields : "");
+        fflush(stdout);
+    }
+}
+
+// unit of per-call statistics and its factor from timer ticks: cycles
+// if possible, otherwise nanoseconds
+
+static const char *speed_unit(double *f)
+{
+    if (timer_cycles(1.0) > 0.0) {
+        *f = timer_cycles(1.0);
+        return "c/call";
+    }
+    *f = 1E9 * timer_sec(1.0);
+
+    return "ns/call";
+}
+
+// leading columns of a CSV or JSON record up to calls_per_sec; the
+// rates are left out if sec is not positive
+
+static void speed_head(caesar_t *aead, const char *timer, const char *op,
+                    unsigned long long mlen, unsigned long long adlen,
+                    unsigned long long calls, double sec)
+{
+    int pfx;
+    double bytes;
+
+    pfx = name_prefix(aead->name);
+    printf(brutus_format == FORMAT_CSV ?
+        "%.*s,%s,%d,%d,%d,%d,%s,%s,%llu,%llu,%llu" :
+        "{\"cipher\":\"%.*s\",\"impl\":\"%s\",\"key\":%d,"
+        "\"nsec\":%d,\"npub\":%d,\"abytes\":%d,\"timer\":\"%s\","
+        "\"op\":\"%s\",\"mlen\":%llu,\"adlen\":%llu,\"calls\":%llu",
+        pfx, aead->name, aead->name[pfx] == '-' ? &aead->name[pfx + 1] : "",
+        aead->keybytes, aead->nsecbytes, aead->npubbytes, aead->abytes,
+        timer, op, mlen, adlen, calls);
+    if (sec > 0.0) {
+        bytes = ((double) calls) * ((double) (mlen + adlen));
+        printf(brutus_format == FORMAT_CSV ? ",%.6f,%.2f,%.1f" :
+            ",\"sec\":%.6f,\"kBps\":%.2f,\"calls_per_sec\":%.1f",
+            sec, bytes / sec / 1000.0, ((double) calls) / sec);
+    } else if (brutus_format == FORMAT_CSV) {
+        printf(",,,");
+    }
+}
+
+// a CSV or JSON record of a test that is not timed by run_speed(): no
+// cycle counts; st (if not NULL) holds statistics of per-call ticks.
+// json holds extra keys (",\"k\":v") or "".
+
+void speed_row(caesar_t *aead, const char *timer, const char *op,
+                unsigned long long mlen, unsigned long long adlen,
+                unsigned long long calls, double sec, const stats_t *st,
+                const char *json)
+{
+    double f;
+    const char *unit;
+
+    speed_head(aead, timer, op, mlen, adlen, calls, sec);
+    if (brutus_format == FORMAT_CSV)
+        printf(",,,");
+    if (st != NULL) {
+        unit = speed_unit(&f);
+        printf(brutus_format == FORMAT_CSV ?
+            ",%d,%d,%s,%.1f,%.1f,%.1f,%.1f,%.1f" :
+            ",\"n\":%d,\"kept\":%d,\"unit\":\"%s\",\"min\":%.1f,"
+            "\"med\":%.1f,\"p90\":%.1f,\"ci_lo\":%.1f,\"ci_hi\":%.1f",
+            st->n, st->kept, unit, f * st->min, f * st->med,
+            f * st->p90, f * st->lo, f * st->hi);
+    } else if (brutus_format == FORMAT_CSV) {
+        printf(",,,,,,,,");
+    }
+    if (brutus_format == FORMAT_CSV)
+        printf("%s\n", brutus_pmu ? ",,,,,," : "");
+    else
+        printf("%s}\n", json);
+}
+
+// a record of an exact count per call (not a time), in the statistics
+// columns as a single sample of the given unit
+
+void speed_count(caesar_t *aead, const char *timer, const char *op,
+                unsigned long long mlen, unsigned long long adlen,
+                const char *unit, double cnt, const char *json)
+{
+    speed_head(aead, timer, op, mlen, adlen, 1, 0.0);
+    printf(brutus_format == FORMAT_CSV ?
+        ",,,,1,1,%s,%.10g,%.10g,%.10g,%.10g,%.10g%s\n" :
+        ",\"n\":1,\"kept\":1,\"unit\":\"%s\",\"min\":%.10g,"
+        "\"med\":%.10g,\"p90\":%.10g,\"ci_lo\":%.10g,\"ci_hi\":%.10g"
+        "%s}\n",
+        unit, cnt, cnt, cnt, cnt, cnt,
+        brutus_format == FORMAT_CSV ? (brutus_pmu ? ",,,,,," : "") : json);
+}
+
+// ratio of two counters, or -1 if either is missing
+
+static double speed_pmu_ratio(const double *cnt, int a, int b, double d)
+{
+    if (cnt[a] < 0.0 || (b >= 0 && cnt[b] <= 0.0) || d <= 0.0)
+        return -1.0;
+
+    return cnt[a] / ((b >= 0 ? cnt[b] : 1.0) * d);
+}
+
+// hardware counter derived metrics: ipc, misses per byte, branch misses
+// per call, stalled cycle fractions
+
+static void speed_pmu_report(speed_ctx_t *sc, int dec)
+{
+    int i;
+    double m[6], bytes, calls;
+    const char *json[6] = {
+        "ipc", "l1d_pb", "llc_pb", "brmiss_pc", "stall_fe", "stall_be"
+    };
+
+    calls = (double) sc->pmu_calls;
+    bytes = calls * ((double) (sc->mlen + sc->adlen));
+    m[0] = speed_pmu_ratio(sc->pmu, PMU_INSNS, PMU_CYCLES, 1.0);
+    m[1] = speed_pmu_ratio(sc->pmu, PMU_L1DMISS, -1, bytes);
+    m[2] = speed_pmu_ratio(sc->pmu, PMU_LLCMISS, -1, bytes);
+    m[3] = speed_pmu_ratio(sc->pmu, PMU_BRMISS, -1, calls);
+    m[4] = speed_pmu_ratio(sc->pmu, PMU_STALLFE, PMU_CYCLES, 1.0);
+    m[5] = speed_pmu_ratio(sc->pmu, PMU_STALLBE, PMU_CYCLES, 1.0);
+
+    switch (brutus_format) {
+
+        case FORMAT_CSV:
+            for (i = 0; i < 6; i++) {
+                if (m[i] >= 0.0)
+                    printf(",%.4g", m[i]);
+                else
+                    printf(",");
+            }
+            break;
+
+        case FORMAT_JSON:
+            for (i = 0; i < 6; i++) {
+                if (m[i] >= 0.0)
+                    printf(",\"%s\":%.4g", json[i], m[i]);
+            }
+            break;
+
+        default:
+            if (sc->pmu_calls == 0)
+                break;
+            printf("[%s] %s(mlen=%llu adlen=%llu) pmu", sc->aead->name,
+                speed_opname[dec], sc->mlen, sc->adlen);
+            if (m[0] >= 0.0)
+                printf("  IPC=%.2f", m[0]);
+            if (m[1] >= 0.0)
+                printf("  L1D=%.4f/B", m[1]);
+            if (m[2] >= 0.0)
+                printf("  LLC=%.5f/B", m[2]);
+            if (m[3] >= 0.0)
+                printf("  br-miss=%.2f/call", m[3]);
+            if (m[4] >= 0.0)
+                printf("  stall-fe=%.1f%%", 100.0 * m[4]);
+            if (m[5] >= 0.0)
+                printf("  stall-be=%.1f%%", 100.0 * m[5]);
+            printf("\n");
+            break;
+    }
+}
+
+// print one speed record. ticks from timer_start() / timer_stop();
+// st (if not NULL) holds statistics of per-call ticks
+
+static void speed_report(speed_ctx_t *sc, int dec,
+                        double ticks, unsigned long long calls, stats_t *st)
+{
+    int pfx;
+    double sec, cyc, bytes, f, ns;
+    const char *unit, *op;
+    caesar_t *aead = sc->aead;
+
+    op = sc->op != NULL ? sc->op : speed_opname[dec];
+
+    sec = timer_sec(ticks);
+    cyc = timer_cycles(ticks);
+    bytes = ((double) calls) * ((double) (sc->mlen + sc->adlen));
+
+    // statistics in cycles if possible, otherwise in nanoseconds
+    unit = speed_unit(&f);
+
+    if (fabs(timer_drift()) > TIMER_DRIFT_MAX) {
+        fprintf(stderr, "!FREQ\t%s core clock drifted %+.1f%% during %s\n",
+            aead->name, 100.0 * timer_drift(), op);
+    }
+
+    switch (brutus_format) {
+
+        case FORMAT_CSV:
+        case FORMAT_JSON:
+            pfx = name_prefix(aead->name);
+            printf(brutus_format == FORMAT_CSV ?
+                "%.*s,%s,%d,%d,%d,%d,%s,%s,%llu,%llu,%llu,%.6f,"
+                "%.2f,%.1f,%.3f,%.1f,%.4f" :
+                "{\"cipher\":\"%.*s\",\"impl\":\"%s\",\"key\":%d,"
+                "\"nsec\":%d,\"npub\":%d,\"abytes\":%d,\"timer\":\"%s\","
+                "\"op\":\"%s\",\"mlen\":%llu,\"adlen\":%llu,"
+                "\"calls\":%llu,\"sec\":%.6f,\"kBps\":%.2f,"
+                "\"calls_per_sec\":%.1f,\"cpb\":%.3f,\"cpc\":%.1f,"
+                "\"drift\":%.4f",
+                pfx, aead->name,
+                aead->name[pfx] == '-' ? &aead->name[pfx + 1] : "",
+                aead->keybytes, aead->nsecbytes, aead->npubbytes,
+                aead->abytes, timer_name(), op,
+                sc->mlen, sc->adlen, calls, sec,
+                bytes / sec / 1000.0, ((double) calls) / sec,
+                bytes > 0.0 ? cyc / bytes : 0.0,
+                cyc / ((double) calls), timer_drift());
+            if (st != NULL) {
+                printf(brutus_format == FORMAT_CSV ?
+                    ",%d,%d,%s,%.1f,%.1f,%.1f,%.1f,%.1f" :
+                    ",\"n\":%d,\"kept\":%d,\"unit\":\"%s\",\"min\":%.1f,"
+                    "\"med\":%.1f,\"p90\":%.1f,\"ci_lo\":%.1f,"
+                    "\"ci_hi\":%.1f",
+                    st->n, st->kept, unit, f * st->min, f * st->med,
+                    f * st->p90, f * st->lo, f * st->hi);
+            } else if (brutus_format == FORMAT_CSV) {
+                printf(",,,,,,,,");
+            }
+            if (brutus_pmu)
+                speed_pmu_report(sc, dec);
+            printf(brutus_format == FORMAT_CSV ? "\n" : "}\n");
+            break;
+
+        default:
+            printf("[%s] %.2f kB/s  %s(mlen=%llu adlen=%llu)",
+                aead->name, bytes / sec / 1000.0, op,
+                sc->mlen, sc->adlen);
+            if (cyc > 0.0) {
+                if (bytes > 0.0)
+                    printf("  %.2f c/B", cyc / bytes);
+                printf("  %.0f c/call", cyc / ((double) calls));
+            }
+            printf("\n");
+
+            if (st != NULL) {
+                printf("[%s] %s(mlen=%llu adlen=%llu) %s  n=%d/%d  "
+                    "min=%.1f  med=%.1f  p90=%.1f  ci95=[%.1f, %.1f]\n",
+                    aead->name, op, sc->mlen, sc->adlen,
+                    unit, st->kept, st->n, f * st->min, f * st->med,
+                    f * st->p90, f * st->lo, f * st->hi);
+            }
+            if (brutus_pmu)
+                speed_pmu_report(sc, dec);
+            break;
+    }
+
+    // results store and baseline comparison, in ns per call
+    if (st != NULL) {
+        results_record(aead, op, sc->mlen, sc->adlen,
+            st->kept, 1E9 * timer_sec(st->med), 1E9 * timer_sec(st->lo),
+            1E9 * timer_sec(st->hi), bytes / sec / 1000.0);
+    } else {
+        ns = 1E9 * sec / ((double) calls);
+        results_record(aead, op, sc->mlen, sc->adlen,
+            0, ns, ns, ns, bytes / sec / 1000.0);
+    }
+}
+
+// single measurement with Fibonacci growth of the loop count
+
+static int speed_loop(speed_ctx_t *sc, int dec, uint64_t tlim,
+                    unsigned long long *ncalls, uint64_t *ticks)
+{
+    int ret;
+    unsigned long long calls, sta, stb;
+    uint64_t stim, etim;
+
+    stim = timer_start();
+    calls = 0;
+    sta = 1;
+    stb = 1;
+    do {
+        if ((ret = speed_calls(sc, dec, sta)) != 0)
+            return ret;
+        calls += sta;
+        sta += stb;
+        stb = sta - stb;
+
+        etim = timer_read() - stim;
+    } while (etim < tlim);
+    etim = timer_stop() - stim;
+
+    *ncalls = calls;
+    *ticks = etim;
+
+    return 0;
+}
+
+static int speed_single(speed_ctx_t *sc, int dec, uint64_t tlim)
+{
+    int ret;
+    unsigned long long calls;
+    uint64_t ticks;
+
+    pmu_start();
+    ret = speed_loop(sc, dec, tlim, &calls, &ticks);
+    sc->pmu_calls = pmu_stop(sc->pmu) == 0 ? calls : 0;
+    if (ret != 0)
+        return ret;
+    speed_report(sc, dec, ticks, calls, NULL);
+
+    return 0;
+}
+
+// warmup and reps independent repetitions of equal length; statistics
+// of ticks per call to st, calls per repetition to ncalls
+
+static int speed_sample(speed_ctx_t *sc, int dec, uint64_t tlim, int reps,
+                        stats_t *st, unsigned long long *ncalls)
+{
+    int ret, i;
+    unsigned long long calls, n;
+    uint64_t stim, etim;
+    double *x;
+
+    // warmup for 1/10 of the time limit; also calibrates the loop count
+    calls = 0;
+    n = 1;
+    stim = timer_start();
+    do {
+        if ((ret = speed_calls(sc, dec, n)) != 0)
+            return ret;
+        calls += n;
+        n += n;
+        etim = timer_read() - stim;
+    } while (etim < tlim / 10);
+    etim = timer_stop() - stim;
+
+    n = (unsigned long long) (((double) calls) * 0.9 * ((double) tlim) /
+        (((double) etim) * ((double) reps)));
+    if (n < 1)
+        n = 1;
+
+    if ((x = calloc(reps, sizeof(double))) == NULL) {
+        perror("speed_sample()");
+        return -1;
+    }
+
+    // counters cover all repetitions but not the warmup
+    pmu_start();
+    for (i = 0; i < reps; i++) {
+        stim = timer_start();
+        if ((ret = speed_calls(sc, dec, n)) != 0) {
+            pmu_stop(sc->pmu);
+            free(x);
+            return ret;
+        }
+        etim = timer_stop() - stim;
+        x[i] = ((double) etim) / ((double) n);    // ticks per call
+    }
+    sc->pmu_calls = pmu_stop(sc->pmu) == 0 ? n * reps : 0;
+    stats_calc(st, x, reps);
+    free(x);
+    *ncalls = n;
+
+    return 0;
+}
+
+static int speed_repeat(speed_ctx_t *sc, int dec, uint64_t tlim)
+{
+    int ret;
+    unsigned long long n;
+    stats_t st;
+
+    if ((ret = speed_sample(sc, dec, tlim, brutus_reps, &st, &n)) != 0)
+        return ret;
+
+    // the median goes to the usual line
+    speed_report(sc, dec, st.med * ((double) n), n, &st);
+
+    return 0;
+}
+
+// setup a speed context on an arena
+
+static void speed_setup(speed_ctx_t *sc, caesar_t *aead, arena_t *ar,
+                        unsigned long long mlen, unsigned long long adlen)
+{
+    int i;
+
+    sc->aead = aead;
+    sc->key = ar->key;
+    sc->nsec = ar->nsec;
+    sc->osec = ar->osec;
+    sc->npub = ar->npub;
+    sc->pt = ar->pt;
+    sc->ad = ar->ad;
+    sc->ct = ar->ct;
+    sc->mlen = mlen;
+    sc->adlen = adlen;
+    sc->clen = 0;
+    for (i = 0; i < PMU_EVENTS; i++)
+        sc->pmu[i] = -1.0;
+    sc->pmu_calls = 0;
+    sc->op = NULL;
+}
+
+// encryption speed on the contents of ar, as speed_repeat() measures it
+// but without a report; nonzero if encrypt fails
+
+int speed_median(caesar_t *aead, arena_t *ar, unsigned long long mlen,
+                unsigned long long adlen, uint64_t tlim, int reps,
+                stats_t *st)
+{
+    unsigned long long n;
+    speed_ctx_t sc;
+
+    speed_setup(&sc, aead, ar, mlen, adlen);
+
+    return speed_sample(&sc, SPEED_ENC, tlim, reps, st, &n);
+}
+
 // actual speedtest routine
 
 int run_speed(caesar_t *aead,
                 unsigned long long mlen, unsigned long long adlen,
-                clock_t limit)
-{
-    int ret, i, sta, stb;
-    unsigned long long clen, t, bytes;
-    clock_t stim, etim;
-    uint8_t key[80], nsec[64], osec[64], npub[64];
-    // that 524304 ABYTES factor comes from Trivia. Don't ask.
-    uint8_t pt[0x10000], ad[0x10000], ct[0x10000 + 524304];
-    double encspeed, decspeed;
-
-    if (mlen > sizeof(pt) || adlen > sizeof(ad)) {
-        fprintf(stderr, "run_speed(): invalid parameters\n");
+                int limit)
+{
+    int ret, dec;
+    uint64_t tlim;
+    arena_t ar;
+    speed_ctx_t sc;
+
+    if (arena_alloc(&ar, aead, mlen, adlen) != 0) {
+        fprintf(stderr, "run_speed(): cannot allocate mlen=%llu adlen=%llu\n",
+            mlen, adlen);
         return -1;
     }
 
-    limit *= CLOCKS_PER_SEC;
+    tlim = timer_ticks(limit);
 
     // random fill contents
-    detseq_fill(pt, mlen);
-    detseq_fill(ad, adlen);
-    detseq_fill(key, aead->keybytes);
-    detseq_fill(nsec, aead->nsecbytes);
-    detseq_fill(npub, aead->npubbytes);
+    detseq_fill(ar.pt, mlen);
+    detseq_fill(ar.ad, adlen);
+    detseq_fill(ar.key, aead->keybytes);
+    detseq_fill(ar.nsec, aead->nsecbytes);
+    detseq_fill(ar.npub, aead->npubbytes);
 
-    encspeed = 0.0;
-    decspeed = 0.0;
+    speed_setup(&sc, aead, &ar, mlen, adlen);
 
-    stim = clock();
-    bytes = 0;
-    sta = 1;
-    stb = 1;
-    do {
-        for (i = 0; i < sta; i++) {
-            clen = 0;
-            ret = aead->encrypt(ct, &clen, pt, mlen, ad, adlen,
-                nsec, npub, key);
-            if (ret != 0 || clen <= 0) {
-                fprintf(stderr, "!ERROR\t%s encrypt(%llu)=%d\n",
-                    aead->name, mlen, ret);
-                return -1;
+    // encrypt first; decrypt needs the ciphertext
+    ret = 0;
+    for (dec = 0; dec < 2 && ret == 0; dec++) {
+        if (brutus_reps > 0)
+            ret = speed_repeat(&sc, dec, tlim);
+        else
+            ret = speed_single(&sc, dec, tlim);
+    }
+    fflush(stdout);
+    arena_free(&ar);
+
+    return ret;
+}
+
+// alignment sensitivity: encrypt with pt, ct, ad or all of them starting
+// at offsets 0..63 from a 64-byte boundary
+
+#define ALIGN_OFFS 64
+#define ALIGN_TRIES 3
+
+// best of ALIGN_TRIES short runs
+
+static int align_rate(speed_ctx_t *sc, uint64_t tlim,
+                    unsigned long long *calls, uint64_t *ticks)
+{
+    int i, ret;
+    unsigned long long c;
+    uint64_t t;
+
+    *calls = 0;
+    *ticks = 1;
+    for (i = 0; i < ALIGN_TRIES; i++) {
+        if ((ret = speed_loop(sc, 0, tlim, &c, &t)) != 0)
+            return ret;
+        if (t > 0 && ((double) c) / ((double) t) >
+            ((double) *calls) / ((double) *ticks)) {
+            *calls = c;
+            *ticks = t;
+        }
+    }
+
+    return 0;
+}
+
+int test_align(caesar_t *aead, int limit)
+{
+    int ret, off, col, slow;
+    unsigned long long mlen, adlen, calls[4];
+    uint64_t tlim, ticks[4];
+    double base, rel[4];
+    arena_t ar;
+    speed_ctx_t sc;
+    char op[32], json[80];
+    const char *colname[4] = { "pt", "ct", "ad", "all" };
+
+    mlen = brutus_mlens.n > 0 ? brutus_mlens.len[0] : 0x1000;
+    adlen = brutus_adlens.n > 0 ? brutus_adlens.len[0] : 0x100;
+
+    if (brutus_verbose) {
+        printf("[%s] Alignment (limit=%d sec)  mlen=%llu  adlen=%llu  "
+            "key=%d  nsec=%d  npub=%d  a=%d\n",
+            aead->name, limit, mlen, adlen, aead->keybytes,
+            aead->nsecbytes, aead->npubbytes, aead->abytes);
+    }
+
+    if (arena_alloc(&ar, aead, mlen + ALIGN_OFFS, adlen + ALIGN_OFFS) != 0)
+        return -1;
+    detseq_fill(ar.pt, mlen + ALIGN_OFFS);
+    detseq_fill(ar.ad, adlen + ALIGN_OFFS);
+    detseq_fill(ar.key, aead->keybytes);
+    detseq_fill(ar.nsec, aead->nsecbytes);
+    detseq_fill(ar.npub, aead->npubbytes);
+    speed_setup(&sc, aead, &ar, mlen, adlen);
+
+    // the time limit is shared by all 4 x 64 + 1 points
+    tlim = timer_ticks(limit) / ((4 * ALIGN_OFFS + 1) * ALIGN_TRIES);
+
+    // aligned reference
+    if ((ret = align_rate(&sc, tlim, &calls[0], &ticks[0])) != 0)
+        goto done;
+    base = ((double) calls[0]) / ((double) ticks[0]);
+    sc.op = "align";                    // not an -f / -s record
+    speed_report(&sc, 0, ticks[0], calls[0], NULL);
+    sc.op = NULL;
+
+    for (off = 0; off < ALIGN_OFFS; off++) {
+        slow = 0;
+        for (col = 0; col < 4; col++) {
+            sc.pt = ar.pt + (col == 0 || col == 3 ? off : 0);
+            sc.ct = ar.ct + (col == 1 || col == 3 ? off : 0);
+            sc.ad = ar.ad + (col == 2 || col == 3 ? off : 0);
+            ret = align_rate(&sc, tlim, &calls[col], &ticks[col]);
+            if (ret != 0)
+                goto done;
+            rel[col] = ((double) calls[col]) /
+                ((double) ticks[col]) / base;
+            if (rel[col] < 1.0 - ALIGN_SLOW)
+                slow++;
+        }
+        if (brutus_format == FORMAT_TEXT) {
+            printf("[%s] off=%2d ", aead->name, off);
+            for (col = 0; col < 4; col++) {
+                printf(" %s=%5.1f%%%c", colname[col], 100.0 * rel[col],
+                    rel[col] < 1.0 - ALIGN_SLOW ? '*' : ' ');
+            }
+            printf(" encrypt(mlen=%llu adlen=%llu)\n", mlen, adlen);
+        } else {
+            // one record per buffer and offset, e.g. op align-pt-13
+            for (col = 0; col < 4; col++) {
+                snprintf(op, sizeof(op), "align-%s-%d", colname[col], off);
+                snprintf(json, sizeof(json), ",\"buf\":\"%s\","
+                    "\"offset\":%d,\"rel\":%.4f", colname[col], off,
+                    rel[col]);
+                speed_row(aead, timer_name(), op, mlen, adlen, calls[col],
+                    timer_sec(ticks[col]), NULL, json);
             }
         }
-        bytes += i * (mlen + adlen);
-        sta += stb;
-        stb = i;
+        if (slow > 0) {
+            fprintf(stderr, "!SLOW\t%s offset %d: %d/4 cases below "
+                "%.0f%%\n", aead->name, off, slow, 100.0 * (1.0 - ALIGN_SLOW));
+        }
+    }
+    fflush(stdout);
+    ret = 0;
 
-        etim = clock() - stim;
-    } while (etim < limit);
+done:
+    arena_free(&ar);
 
-    encspeed = ((double) CLOCKS_PER_SEC) * ((double) bytes) / ((double) etim);
-    printf("[%s] %.2f kB/s  encrypt(mlen=%llu adlen=%llu)\n",
-        aead->name, encspeed / 1000.0, mlen, adlen);
+    return ret;
+}
 
-    stim = clock();
-    bytes = 0;
-    sta = 1;
-    stb = 1;
+// in-place (c == m) versus out-of-place encryption and decryption.
+// in-place decryption destroys its ciphertext, so decryption in both
+// modes runs over a ring of ciphertext copies that is refilled between
+// timed passes.
+
+#define INPLACE_RING 0x4000             // bytes of copies, about L1 size
+
+// decrypt ring copies into pt (out-of-place) or onto themselves until
+// tlim ticks have been spent in decrypt
+
+static int inplace_dec(speed_ctx_t *sc, uint8_t *ring, size_t stride,
+                        int k, int inp, uint64_t tlim,
+                        unsigned long long *calls, uint64_t *ticks)
+{
+    int i, ret;
+    unsigned long long mlen;
+    uint64_t stim;
+    caesar_t *aead = sc->aead;
+
+    *calls = 0;
+    *ticks = 0;
     do {
-        for (i = 0; i < sta; i++) {
-            ret = aead->decrypt(pt, &t, osec, ct, clen, ad,
-                adlen, npub, key);
+        for (i = 0; i < k; i++)
+            memcpy(ring + i * stride, sc->ct, sc->clen);
+        stim = timer_start();
+        for (i = 0; i < k; i++) {
+            ret = aead->decrypt(inp ? ring + i * stride : sc->pt, &mlen,
+                sc->osec, ring + i * stride, sc->clen, sc->ad, sc->adlen,
+                sc->npub, sc->key);
             if (ret != 0) {
+                timer_stop();
                 fprintf(stderr, "!ERROR\t%s decrypt(%llu)=%d\n",
-                    aead->name, clen, ret);
+                    aead->name, sc->clen, ret);
                 return -2;
             }
         }
-        bytes += i * (mlen + adlen);
-        sta += stb;
-        stb = i;
+        *ticks += timer_stop() - stim;
+        *calls += k;
+    } while (*ticks < tlim);
 
-        etim = clock() - stim;
-    } while (etim < limit);
+    return 0;
+}
 
-    decspeed = ((double) CLOCKS_PER_SEC) * ((double) bytes) / ((double) etim);
-    printf("[%s] %.2f kB/s  decrypt(mlen=%llu adlen=%llu)\n",
-        aead->name, decspeed / 1000.0, mlen, adlen);
-    fflush(stdout);
+int test_inplace(caesar_t *aead, int limit)
+{
+    int ret, i, k, inp, op;
+    unsigned long long calls[2][2], mlen;
+    unsigned long long deflen[3] = { 64, 1536, 0x10000 };
+    uint64_t tlim, ticks[2][2];
+    double tpc[2][2], cpt, sec, ns;
+    size_t stride;
+    lenlist_t ml;
+    arena_t ar, rg;
+    speed_ctx_t sc;
+    char name[32], json[40];
+    const char *where[2] = { "out-of-place", "in-place" };
+    const char *opname[2] = { "outplace", "inplace" };
 
-    return 0;
+    if (aead->nooverlap) {
+        if (brutus_verbose) {
+            printf("!INFO\t%s declares CRYPTO_NOOVERLAP, "
+                "no in-place test.\n", aead->name);
+        }
+        return 0;
+    }
+
+    ml = brutus_mlens;
+    if (ml.n == 0) {
+        ml.n = 3;
+        ml.len = deflen;
+    }
+
+    if (brutus_verbose) {
+        printf("[%s] In-place (limit=%d sec)  "
+            "key=%d  nsec=%d  npub=%d  a=%d\n",
+            aead->name, limit, aead->keybytes, aead->nsecbytes,
+            aead->npubbytes, aead->abytes);
+    }
+
+    // 4 measurements per length
+    tlim = timer_ticks(limit) / (4 * ml.n);
+    cpt = timer_cycles(1.0);
+    ret = 0;
+
+    for (i = 0; i < ml.n && ret == 0; i++) {
+        mlen = ml.len[i];
+
+        // pt doubles as the in-place buffer, so it must fit a ciphertext
+        if (arena_alloc(&ar, aead, mlen + aead->abytes, 0) != 0)
+            return -1;
+        stride = (mlen + aead->abytes + ARENA_ALIGN - 1) &
+            ~((size_t) ARENA_ALIGN - 1);
+        k = INPLACE_RING / stride > 1 ? INPLACE_RING / stride : 1;
+        if (arena_alloc(&rg, aead, k * stride, 0) != 0) {
+            arena_free(&ar);
+            return -1;
+        }
+        detseq_fill(ar.pt, mlen);
+        detseq_fill(ar.key, aead->keybytes);
+        detseq_fill(ar.nsec, aead->nsecbytes);
+        detseq_fill(ar.npub, aead->npubbytes);
+        speed_setup(&sc, aead, &ar, mlen, 0);
+
+        // out-of-place first: ar.ct keeps the ciphertext of the original
+        // plaintext for the decryption ring
+        for (inp = 0; inp < 2 && ret == 0; inp++) {
+            sc.ct = inp ? ar.pt : ar.ct;
+            ret = speed_loop(&sc, SPEED_ENC, tlim,
+                &calls[inp][SPEED_ENC], &ticks[inp][SPEED_ENC]);
+        }
+        sc.ct = ar.ct;
+        sc.pt = ar.xt;
+        for (inp = 0; inp < 2 && ret == 0; inp++) {
+            ret = inplace_dec(&sc, rg.pt, stride, k, inp, tlim,
+                &calls[inp][SPEED_DEC], &ticks[inp][SPEED_DEC]);
+        }
+        arena_free(&rg);
+        arena_free(&ar);
+        if (ret != 0)
+            break;
+
+        for (op = SPEED_ENC; op <= SPEED_DEC; op++) {
+            for (inp = 0; inp < 2; inp++) {
+                tpc[inp][op] = ((double) ticks[inp][op]) /
+                    ((double) calls[inp][op]);
+            }
+            for (inp = 0; inp < 2; inp++) {
+                sec = timer_sec(ticks[inp][op]);
+                snprintf(name, sizeof(name), "%s-%s", opname[inp],
+                    speed_opname[op]);
+                if (brutus_format == FORMAT_TEXT) {
+                    printf("[%s] %.2f kB/s  %s %s(mlen=%llu adlen=0)",
+                        aead->name, ((double) mlen) /
+                        timer_sec(tpc[inp][op]) / 1000.0,
+                        where[inp], speed_opname[op], mlen);
+                    if (cpt > 0.0)
+                        printf("  %.0f c/call", cpt * tpc[inp][op]);
+                    if (inp)
+                        printf("  %+.1f%%", 100.0 *
+                            (tpc[0][op] / tpc[1][op] - 1.0));
+                    printf("\n");
+                } else {
+                    snprintf(json, sizeof(json), ",\"rel\":%.4f",
+                        tpc[0][op] / tpc[inp][op]);
+                    speed_row(aead, timer_name(), name, mlen, 0,
+                        calls[inp][op], sec, NULL, json);
+                }
+                ns = 1E9 * sec / ((double) calls[inp][op]);
+                results_record(aead, name, mlen, 0, 0, ns, ns, ns,
+                    ((double) (mlen * calls[inp][op])) / sec / 1000.0);
+            }
+        }
+        fflush(stdout);
+    }
+
+    return ret;
 }
 
 // comprehensible speed test
@@ -100,6 +817,9 @@ int run_speed(caesar_t *aead,
 int test_speed(caesar_t *aead, int limit)
 {
     uint64_t len;
+    int i, j;
+    unsigned long long zero = 0;
+    lenlist_t ml, al;
 
     if (brutus_verbose) {
         printf("[%s] Speed Test (limit=%d sec)  "
@@ -108,6 +828,25 @@ int test_speed(caesar_t *aead, int limit)
             aead->npubbytes, aead->abytes);
     }
 
+    // user-defined sweep over the mlen x adlen grid
+    if (brutus_mlens.n > 0 || brutus_adlens.n > 0) {
+        ml = brutus_mlens;
+        al = brutus_adlens;
+        if (ml.n == 0) {
+            ml.n = 1;
+            ml.len = &zero;
+        }
+        if (al.n == 0) {
+            al.n = 1;
+            al.len = &zero;
+        }
+        for (i = 0; i < ml.n; i++) {
+            for (j = 0; j < al.n; j++)
+                run_speed(aead, ml.len[i], al.len[j], limit);
+        }
+        return 0;
+    }
+
     for (len = 0x10; len <= 0x10000; len <<= 2) {
         run_speed(aead, len, 0, limit);
         run_speed(aead, 0, len, limit);
@@ -0,0 +1,137 @@
+// stats.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Robust statistics for repeated measurements: outlier rejection,
+// order statistics and a bootstrap confidence interval of the median.
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "brutus.h"
+
+// bootstrap resamples
+
+#ifndef STATS_BOOTSTRAP
+#define STATS_BOOTSTRAP 1000
+#endif
+
+static int stats_cmp(const void *a, const void *b)
+{
+    double x = *((const double *) a), y = *((const double *) b);
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// quantile 0 <= q <= 1 of a sorted vector (linear interpolation)
+
+double stats_quantile(const double *x, int n, double q)
+{
+    double f;
+    int i;
+
+    if (n <= 0)
+        return 0.0;
+    f = q * (n - 1);
+    i = (int) floor(f);
+    if (i >= n - 1)
+        return x[n - 1];
+    f -= i;
+
+    return (1.0 - f) * x[i] + f * x[i + 1];
+}
+
+// compute statistics of n samples in x. x is sorted and outliers are
+// moved to the end; st->kept tells how many survived.
+
+void stats_calc(stats_t *st, double *x, int n)
+{
+    int i, j, b;
+    double med, mad, *dev, *boot;
+    uint32_t r;
+
+    memset(st, 0, sizeof(stats_t));
+    st->n = n;
+    if (n <= 0)
+        return;
+
+    qsort(x, n, sizeof(double), stats_cmp);
+
+    // reject outliers further than 3 scaled MADs from the median
+    med = stats_quantile(x, n, 0.5);
+    if ((dev = calloc(n, sizeof(double))) == NULL) {
+        perror("stats_calc()");
+        return;
+    }
+    for (i = 0; i < n; i++)
+        dev[i] = fabs(x[i] - med);
+    qsort(dev, n, sizeof(double), stats_cmp);
+    mad = 1.4826 * stats_quantile(dev, n, 0.5);
+
+    j = 0;
+    for (i = 0; i < n; i++) {
+        if (mad <= 0.0 || fabs(x[i] - med) <= 3.0 * mad)
+            dev[j++] = x[i];
+    }
+    st->kept = j;
+    for (i = 0; i < n; i++) {
+        if (!(mad <= 0.0 || fabs(x[i] - med) <= 3.0 * mad))
+            dev[j++] = x[i];
+    }
+    memcpy(x, dev, n * sizeof(double));
+    free(dev);
+
+    n = st->kept;
+    st->min = x[0];
+    st->max = x[n - 1];
+    st->med = stats_quantile(x, n, 0.5);
+    st->p90 = stats_quantile(x, n, 0.9);
+
+    // percentile bootstrap of the median. own LCG; don't touch detseq.
+    if ((boot = calloc(STATS_BOOTSTRAP + n, sizeof(double))) == NULL) {
+        perror("stats_calc()");
+        return;
+    }
+    r = 0x2545F491;
+    for (b = 0; b < STATS_BOOTSTRAP; b++) {
+        for (i = 0; i < n; i++) {
+            r = 1664525 * r + 1013904223;
+            boot[STATS_BOOTSTRAP + i] = x[(((uint64_t) r) * n) >> 32];
+        }
+        qsort(&boot[STATS_BOOTSTRAP], n, sizeof(double), stats_cmp);
+        boot[b] = stats_quantile(&boot[STATS_BOOTSTRAP], n, 0.5);
+    }
+    qsort(boot, STATS_BOOTSTRAP, sizeof(double), stats_cmp);
+    st->lo = stats_quantile(boot, STATS_BOOTSTRAP, 0.025);
+    st->hi = stats_quantile(boot, STATS_BOOTSTRAP, 0.975);
+    free(boot);
+}
+
+// least squares fit y = a + b * x
+
+void stats_linfit(const double *x, const double *y, int n,
+                double *a, double *b)
+{
+    int i;
+    double sx, sy, sxx, sxy, d;
+
+    sx = 0.0;
+    sy = 0.0;
+    sxx = 0.0;
+    sxy = 0.0;
+    for (i = 0; i < n; i++) {
+        sx += x[i];
+        sy += y[i];
+        sxx += x[i] * x[i];
+        sxy += x[i] * y[i];
+    }
+    d = n * sxx - sx * sx;
+    if (n < 2 || d == 0.0) {
+        *a = n > 0 ? sy / n : 0.0;
+        *b = 0.0;
+        return;
+    }
+    *b = (n * sxy - sx * sy) / d;
+    *a = (sy - *b * sx) / n;
+}
@@ -0,0 +1,286 @@
+// timer.c
+// 17-Oct-26  Markku-Juhani O. Saarinen <mjos@iki.fi>
+
+// Pluggable timers for the speed tests: clock(), CLOCK_MONOTONIC_RAW,
+// serialized TSC and perf_event core cycle counter.
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TIMER_HAVE_TSC
+#endif
+
+#include "brutus.h"
+
+// selected timer and its calibration
+
+int brutus_timer = TIMER_CLOCK;
+
+static double timer_hz = CLOCKS_PER_SEC;    // ticks per second
+static double timer_cpt = 0.0;              // core cycles per tick
+static double timer_tsc_hz = 0.0;           // TSC frequency
+static double timer_core_hz = 0.0;          // measured core frequency
+static int timer_perf_fd = -1;              // core cycles counter
+static pid_t timer_perf_pid = 0;            // process that opened it
+static uint64_t timer_aux0, timer_ref0;     // for frequency drift check
+static double timer_last_drift = 0.0;
+
+static const char *timer_names[TIMER_TYPES] = {
+    "clock", "monotonic", "TSC", "perf"
+};
+
+// raw readers
+
+static uint64_t timer_mono_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+    return ((uint64_t) ts.tv_sec) * 1000000000LLU + ts.tv_nsec;
+}
+
+static uint64_t timer_perf_cycles()
+{
+    uint64_t x;
+
+    if (timer_perf_fd < 0 ||
+        read(timer_perf_fd, &x, sizeof(x)) != sizeof(x))
+        return 0;
+
+    return x;
+}
+
+static int timer_perf_open()
+{
+    struct perf_event_attr pe;
+
+    memset(&pe, 0, sizeof(pe));
+    pe.size = sizeof(pe);
+    pe.type = PERF_TYPE_HARDWARE;
+    pe.config = PERF_COUNT_HW_CPU_CYCLES;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+
+    timer_perf_pid = getpid();
+
+    return syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+}
+
+// read the raw counter of the current timer
+
+static uint64_t timer_raw(int serialize)
+{
+#ifdef TIMER_HAVE_TSC
+    unsigned int aux;
+    uint64_t x;
+#endif
+
+    switch (brutus_timer) {
+
+        case TIMER_MONO:
+            return timer_mono_ns();
+
+#ifdef TIMER_HAVE_TSC
+        case TIMER_TSC:
+            if (serialize > 0) {            // start: nothing leaks in
+                _mm_lfence();
+                x = __rdtsc();
+                _mm_lfence();
+            } else if (serialize < 0) {     // stop: everything retired
+                x = __rdtscp(&aux);
+                _mm_lfence();
+            } else {
+                x = __rdtsc();
+            }
+            return x;
+#endif
+
+        case TIMER_PERF:
+            return timer_perf_cycles();
+
+        default:
+            return clock();
+    }
+}
+
+// time stamps for a measurement interval
+
+uint64_t timer_start()
+{
+    // the counter only follows the thread that opened it; reopen in
+    // forked test processes
+    if (timer_perf_fd >= 0 && timer_perf_pid != getpid()) {
+        close(timer_perf_fd);
+        timer_perf_fd = timer_perf_open();
+    }
+    timer_aux0 = timer_perf_cycles();
+    timer_ref0 = timer_mono_ns();
+
+    return timer_raw(1);
+}
+
+uint64_t timer_read()
+{
+    return timer_raw(0);
+}
+
+uint64_t timer_stop()
+{
+    uint64_t t, aux, ref;
+    double hz;
+
+    t = timer_raw(-1);
+
+    // compare core clock against the calibration
+    timer_last_drift = 0.0;
+    if (timer_perf_fd >= 0 && timer_core_hz > 0.0) {
+        aux = timer_perf_cycles() - timer_aux0;
+        ref = timer_mono_ns() - timer_ref0;
+        if (ref > 1000000) {
+            hz = 1E9 * ((double) aux) / ((double) ref);
+            timer_last_drift = hz / timer_core_hz - 1.0;
+        }
+    }
+
+    return t;
+}
+
+// relative core frequency change during the last start..stop interval
+
+double timer_drift()
+{
+    return timer_last_drift;
+}
+
+// conversions
+
+double timer_sec(double ticks)
+{
+    return ticks / timer_hz;
+}
+
+uint64_t timer_ticks(double sec)
+{
+    return (uint64_t) (sec * timer_hz);
+}
+
+double timer_cycles(double ticks)
+{
+    return ticks * timer_cpt;
+}
+
+const char *timer_name()
+{
+    if (brutus_timer < 0 || brutus_timer >= TIMER_TYPES)
+        return "?";
+    return timer_names[brutus_timer];
+}
+
+// calibrate TSC and core clock against CLOCK_MONOTONIC_RAW
+
+static void timer_calibrate()
+{
+    uint64_t t0, t1, c0, c1, ns;
+#ifdef TIMER_HAVE_TSC
+    uint64_t s0, s1;
+
+    s0 = __rdtsc();
+#endif
+    c0 = timer_perf_cycles();
+    t0 = timer_mono_ns();
+
+    // busy wait 100 ms so that the core is running at full speed
+    do {
+        t1 = timer_mono_ns();
+    } while (t1 - t0 < 100000000);
+
+    c1 = timer_perf_cycles();
+#ifdef TIMER_HAVE_TSC
+    s1 = __rdtsc();
+#endif
+    ns = t1 - t0;
+
+#ifdef TIMER_HAVE_TSC
+    timer_tsc_hz = 1E9 * ((double) (s1 - s0)) / ((double) ns);
+#endif
+    if (timer_perf_fd >= 0 && c1 > c0)
+        timer_core_hz = 1E9 * ((double) (c1 - c0)) / ((double) ns);
+}
+
+// initialize the timer. returns the timer type actually used.
+
+int timer_init(int type)
+{
+    double core_hz;
+
+    if (timer_perf_fd < 0)
+        timer_perf_fd = timer_perf_open();
+
+#ifndef TIMER_HAVE_TSC
+    if (type == TIMER_TSC)
+        type = TIMER_MONO;
+#endif
+    if (type == TIMER_PERF && timer_perf_fd < 0) {
+        fprintf(stderr, "!INFO\tperf cycle counter unavailable, "
+            "using TSC / monotonic timer.\n");
+#ifdef TIMER_HAVE_TSC
+        type = TIMER_TSC;
+#else
+        type = TIMER_MONO;
+#endif
+    }
+    if (type < 0 || type >= TIMER_TYPES)
+        type = TIMER_CLOCK;
+    brutus_timer = type;
+
+    timer_calibrate();
+
+    // best guess of the core clock: measured or TSC
+    core_hz = timer_core_hz > 0.0 ? timer_core_hz : timer_tsc_hz;
+
+    switch (type) {
+        case TIMER_MONO:
+            timer_hz = 1E9;
+            break;
+        case TIMER_TSC:
+            timer_hz = timer_tsc_hz;
+            break;
+        case TIMER_PERF:
+            timer_hz = timer_core_hz;
+            break;
+        default:
+            timer_hz = CLOCKS_PER_SEC;
+            break;
+    }
+    timer_cpt = core_hz / timer_hz;
+
+    if (brutus_verbose) {
+        printf("\ttimer=%s  tsc=%.1f MHz  core=", timer_name(),
+            timer_tsc_hz / 1E6);
+        if (timer_core_hz > 0.0)
+            printf("%.1f MHz", timer_core_hz / 1E6);
+        else
+            printf("unknown (cycles assume TSC rate)");
+        printf("\n");
+    }
+
+    // turbo boost or frequency scaling skews TSC-based cycle counts
+    if (timer_core_hz > 0.0 && timer_tsc_hz > 0.0 &&
+        fabs(timer_core_hz / timer_tsc_hz - 1.0) > TIMER_DRIFT_MAX) {
+        fprintf(stderr, "!FREQ\tcore clock %.1f MHz differs from TSC %.1f MHz "
+            "(%+.1f%%); turbo or frequency scaling active.\n",
+            timer_core_hz / 1E6, timer_tsc_hz / 1E6,
+            100.0 * (timer_core_hz / timer_tsc_hz - 1.0));
+    }
+    fflush(stdout);
+
+    return type;
+}
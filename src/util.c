@@ -6,24 +6,49 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 #include "brutus.h"
 
-// Deterministic sequences (Fibonacci generator)
+// Deterministic sequences. Version 0 is the Fibonacci generator that the
+// KAT outputs are defined with; one step per byte of detseq_fill(), of
+// which only the top 8 bits are used. Version 1 (-g1) reads the stream of
+// the counter-based generator in gen.c from byte offset detseq_pos.
+// The state is per thread; a new thread starts from seed 0.
 
-uint32_t detseq_a = 0, detseq_b = 1;
+int brutus_detseq = DETSEQ_FIB;
+__thread uint32_t detseq_a = 0, detseq_b = 1;
+__thread gen_t detseq_gen = { GEN_K0, 0 };
+__thread uint64_t detseq_pos = 0;
 
 void detseq_seed(uint32_t seed)
 {
     detseq_a = 0xDEAD4BAD * seed;       // prime
     detseq_b = 1;
+    gen_key(&detseq_gen, seed);
+    detseq_pos = 0;
 }
 
 uint32_t detseq32()
 {
     uint32_t t;
+    uint8_t b[4];
+
+    if (brutus_detseq == DETSEQ_CTR) {
+        if ((detseq_pos & 3) == 0) {
+            t = gen_word(&detseq_gen, detseq_pos >> 2);
+        } else {
+            gen_fill(&detseq_gen, detseq_pos, b, 4);
+            t = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t) b[3] << 24);
+        }
+        detseq_pos += 4;
+        return t;
+    }
 
     t = detseq_a + detseq_b;
     detseq_a = detseq_b;
@@ -32,14 +57,34 @@ uint32_t detseq32()
     return t;
 }
 
-void detseq_fill(void *p, int len)
+void detseq_fill(void *p, size_t len)
 {
-    int i;
+    size_t i;
+
+    if (brutus_detseq == DETSEQ_CTR) {
+        gen_fill(&detseq_gen, detseq_pos, p, len);
+        detseq_pos += len;
+        return;
+    }
 
     for (i = 0; i < len; i++)
         ((uint8_t *) p)[i] = detseq32() >> 24;
 }
 
+// FNV-1a
+
+uint64_t hash_fnv(uint64_t h, const void *p, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        h ^= ((const uint8_t *) p)[i];
+        h *= 0x100000001B3LLU;
+    }
+
+    return h;
+}
+
 // Hex Dump
 
 void hex_dump(void *p, int len)
@@ -72,18 +117,447 @@ void hex_dump(void *p, int len)
     }
 }
 
+// length of the cipher part of "cipher-implementation" name
+
+int name_prefix(const char *name)
+{
+    int i;
+
+    for (i = 0; name[i] != 0 && name[i] != '-'; i++)
+        ;
+
+    return i;
+}
+
+// number with an optional binary K, M or G suffix
+
+static unsigned long long parse_size(const char *s, char **ep)
+{
+    unsigned long long x;
+
+    x = strtoull(s, ep, 0);
+    if (*ep != s) {
+        switch (**ep) {
+            case 'G':
+                x <<= 10;
+                // fall through
+            case 'M':
+                x <<= 10;
+                // fall through
+            case 'K':
+                x <<= 10;
+                (*ep)++;
+        }
+    }
+
+    return x;
+}
+
+// parse a length list such as "0,16,1500", "16:64K:*4" or "0:256:+32"
+// and append to lst. returns number of lengths or -1 on error.
+
+int parse_lengths(lenlist_t *lst, const char *spec)
+{
+    unsigned long long a, b, s, *p;
+    char *ep, op;
+
+    while (*spec != 0) {
+        a = parse_size(spec, &ep);
+        if (ep == spec)
+            return -1;
+        b = a;
+        s = 1;
+        op = '+';
+        if (*ep == ':') {
+            spec = ep + 1;
+            b = parse_size(spec, &ep);
+            if (ep == spec)
+                return -1;
+            op = '*';
+            s = 4;
+            if (*ep == ':' && ep[1] != 0) {
+                op = ep[1];
+                spec = ep + 2;
+                s = strtoull(spec, &ep, 0);
+                if (ep == spec || (op != '+' && op != '*'))
+                    return -1;
+            }
+        }
+        if (s == 0 || (op == '*' && (s < 2 || a == 0)))
+            return -1;
+
+        while (a <= b) {
+            if (lst->n >= LENLIST_MAX) {
+                fprintf(stderr, "parse_lengths(): more than %d lengths\n",
+                    LENLIST_MAX);
+                return -1;
+            }
+            p = realloc(lst->len, (lst->n + 1) * sizeof(*p));
+            if (p == NULL) {
+                perror("parse_lengths()");
+                return -1;
+            }
+            lst->len = p;
+            lst->len[lst->n++] = a;
+
+            // stop where the next length would overflow
+            if (op == '+') {
+                if (s > b - a)
+                    break;
+                a += s;
+            } else {
+                if (a > b / s)
+                    break;
+                a *= s;
+            }
+        }
+
+        if (*ep == ',')
+            ep++;
+        else if (*ep != 0)
+            return -1;
+        spec = ep;
+    }
+
+    return lst->n;
+}
+
+// in-process isolation (-X): faults and aborts in the candidate are
+// caught on an alternate signal stack and unwound with siglongjmp. a
+// candidate that has crashed once is run in a child process from then
+// on. a test with a time limit is unwound in-process only when another
+// process watches this one (brutus_watched) and kills it should the
+// unwinding leave a lock held; otherwise it is forked.
+
+int brutus_inproc = 0;
+int brutus_watched = 0;
+
+// watchdog (-T): seconds per test, and the end of the current
+// candidate's share and of the whole run (monotonic clock, 0 = none)
+
+double brutus_tlimit = 0.0;
+static double harness_cend = 0.0;
+static double harness_gend = 0.0;
+static double harness_units = 0.0;      // planned work left, see below
+
+static const int harness_sig[HARNESS_SIGS] = {
+    SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, HARNESS_TIMEOUT
+};
+static sigjmp_buf harness_env;
+static volatile sig_atomic_t harness_active = 0;
+static pthread_t harness_thread;
+static pid_t harness_pid = 0;
+static timer_t harness_timer;
+static int harness_timer_ok = 0;
+
+// names of tests for timeout records
+
+static const struct {
+    int (*func)(caesar_t *, int);
+    const char *name;
+} harness_test[] = {
+    { test_speed, "speed" },            { test_throughput, "throughput" },
+    { test_coherence, "coherence" },    { test_kat, "kat" },
+    { test_xprmnt, "xprmnt" },          { test_scaling, "scaling" },
+    { test_align, "align" },            { test_inplace, "inplace" },
+    { test_cold, "cold" },              { test_agility, "agility" },
+    { test_mix, "mix" },                { test_insn, "insn" },
+    { test_best, "best" },             { test_digest, "digest" },
+    { NULL, "test" }
+};
+
+static const char *harness_name(int (*test_func)(caesar_t *, int))
+{
+    int i;
+
+    for (i = 0; harness_test[i].func != NULL; i++) {
+        if (harness_test[i].func == test_func)
+            break;
+    }
+
+    return harness_test[i].name;
+}
+
+double harness_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((double) ts.tv_sec) + 1E-9 * ((double) ts.tv_nsec);
+}
+
+// wall clock budget of the whole run, secs; 0 = none
+
+void harness_deadline(double sec)
+{
+    harness_gend = sec > 0.0 ? harness_now() + sec : 0.0;
+}
+
+// time left of the whole run; 0 = no budget, else at least 1 ms
+
+double harness_left()
+{
+    double t;
+
+    if (harness_gend <= 0.0)
+        return 0.0;
+    t = harness_gend - harness_now();
+
+    return t > 1E-3 ? t : 1E-3;
+}
+
+// the rest of the run is planned as units of work that each get an
+// equal share of the time left. a (candidate, test) pair run serially is
+// one unit; N of them run in parallel take one unit of wall time.
+
+void harness_plan(double units)
+{
+    harness_units = units;
+}
+
+// time of one unit; 0 = no budget. past the plan, all that is left
+
+double harness_unit()
+{
+    double t;
+
+    t = harness_left();
+    if (harness_units > 1.0)
+        t /= harness_units;
+
+    return t;
+}
+
+void harness_spend(double units)
+{
+    harness_units = harness_units > units ? harness_units - units : 0.0;
+}
+
+// budget of the current candidate, secs; 0 = none
+
+void harness_budget(double sec)
+{
+    harness_cend = sec > 0.0 ? harness_now() + sec : 0.0;
+}
+
+// time limit for the next test; 0 = none, negative if exhausted
+
+static double harness_limit()
+{
+    double lim, t;
+
+    lim = brutus_tlimit;
+    if (harness_cend > 0.0) {
+        t = harness_cend - harness_now();
+        if (t <= 0.0)
+            return -1.0;
+        if (lim <= 0.0 || t < lim)
+            lim = t;
+    }
+
+    return lim;
+}
+
+static void harness_timeout(int (*test_func)(caesar_t *, int),
+                            caesar_t *aead, double sec)
+{
+    const char *name;
+
+    name = harness_name(test_func);
+    printf("\n[TIMEOUT]\n");
+    fflush(stdout);
+    if (sec < 0.0) {
+        fprintf(stderr, "!TIMEOUT\t%s %s budget exhausted\n",
+            aead->name, name);
+        sec = 0.0;
+    } else {
+        fprintf(stderr, "!TIMEOUT\t%s %s after %.2f sec\n",
+            aead->name, name, sec);
+    }
+    results_record(aead, "timeout", 0, 0, 0, 1E9 * sec, 1E9 * sec,
+        1E9 * sec, 0.0);
+}
+
+static void harness_fault(int sig)
+{
+    // watchdog expired just as the test finished
+    if (sig == HARNESS_TIMEOUT && !harness_active)
+        return;
+    if (harness_active && getpid() == harness_pid) {
+        if (pthread_equal(pthread_self(), harness_thread)) {
+            harness_active = 0;
+            siglongjmp(harness_env, sig);
+        }
+        // timer went to another thread of the test
+        if (sig == HARNESS_TIMEOUT) {
+            pthread_kill(harness_thread, sig);
+            return;
+        }
+    }
+    // another thread or a child; the fault repeats and terminates it
+    signal(sig, SIG_DFL);
+    // an abort is not repeated by returning, unless abort() does so
+    if (sig == SIGABRT)
+        raise(sig);
+}
+
+static int harness_setup()
+{
+    int i;
+    stack_t ss;
+    struct sigaction sa;
+    struct sigevent sev;
+
+    if ((ss.ss_sp = malloc(HARNESS_STACK)) == NULL)
+        return -1;
+    ss.ss_size = HARNESS_STACK;
+    ss.ss_flags = 0;
+    if (sigaltstack(&ss, NULL) != 0) {
+        perror("sigaltstack()");
+        free(ss.ss_sp);
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = harness_fault;
+    sa.sa_flags = SA_ONSTACK;
+    for (i = 0; i < HARNESS_SIGS; i++) {
+        if (sigaction(harness_sig[i], &sa, NULL) != 0) {
+            perror("sigaction()");
+            return -1;
+        }
+    }
+
+    // watchdog timer of this process
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_SIGNAL;
+    sev.sigev_signo = HARNESS_TIMEOUT;
+    harness_timer_ok = timer_create(CLOCK_MONOTONIC, &sev,
+        &harness_timer) == 0;
+    harness_pid = getpid();
+
+    return 0;
+}
+
+static void harness_arm(double sec)
+{
+    struct itimerspec its;
+
+    if (!harness_timer_ok)
+        return;
+    memset(&its, 0, sizeof(its));
+    if (sec > 0.0) {
+        its.it_value.tv_sec = (time_t) sec;
+        its.it_value.tv_nsec = (long) (1E9 * (sec - floor(sec)));
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+            its.it_value.tv_nsec = 1;
+    }
+    timer_settime(harness_timer, 0, &its, NULL);
+}
+
+static int harness_inproc(int (*test_func)(caesar_t *, int),
+                        caesar_t *aead, int val, double lim)
+{
+    int sig, ret;
+    uint32_t a, b;
+    uint64_t pos;
+    gen_t g;
+    double t0;
+
+    // a child would not advance the parent's sequence either
+    a = detseq_a;
+    b = detseq_b;
+    g = detseq_gen;
+    pos = detseq_pos;
+    harness_thread = pthread_self();
+
+    ret = -1;
+    t0 = harness_now();
+    if ((sig = sigsetjmp(harness_env, 1)) == 0) {
+        harness_active = 1;
+        harness_arm(lim);
+        ret = test_func(aead, val);
+        harness_active = 0;
+        harness_arm(0.0);
+    } else {
+        // buffers of the test are lost; the candidate is isolated from
+        // now on as its state may be corrupt
+        harness_arm(0.0);
+        fflush(stdout);
+        if (sig == HARNESS_TIMEOUT)
+            harness_timeout(test_func, aead, harness_now() - t0);
+        else
+            printf("\n[SIGNAL %d]\n", sig);
+        aead->crashed = 1;
+    }
+    fflush(stdout);
+
+    detseq_a = a;
+    detseq_b = b;
+    detseq_gen = g;
+    detseq_pos = pos;
+
+    return ret;
+}
+
 // a forking test harness (against cipher crashes & memory leaks)
 
 int test_harness(int (*test_func)(caesar_t *, int), caesar_t *aead, int val)
 {
     pid_t p;
     int stat;
+    double lim, t0, t;
+    sigset_t chld, omask;
+    struct timespec ts;
+
+    lim = harness_limit();
+    if (lim < 0.0) {
+        harness_timeout(test_func, aead, -1.0);
+        return -1;
+    }
+
+    if (brutus_inproc && harness_pid != getpid() && harness_setup() != 0)
+        brutus_inproc = 0;
+    if (brutus_inproc && !aead->crashed &&
+        (lim <= 0.0 || brutus_watched))
+        return harness_inproc(test_func, aead, val, lim);
+
+    // with a time limit, wait for SIGCHLD with a timeout
+    if (lim > 0.0) {
+        sigemptyset(&chld);
+        sigaddset(&chld, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &chld, &omask);
+    }
+    t0 = harness_now();
 
     p = fork();
     if (p == 0) {
+        if (lim > 0.0)
+            sigprocmask(SIG_SETMASK, &omask, NULL);
         exit(test_func(aead, val));
     }
-    waitpid(p, &stat, 0);
+
+    if (lim > 0.0) {
+        while (p > 0 && waitpid(p, &stat, WNOHANG) == 0) {
+            t = t0 + lim - harness_now();
+            if (t <= 0.0) {
+                kill(p, SIGKILL);
+                waitpid(p, &stat, 0);
+                fflush(stdout);
+                harness_timeout(test_func, aead, harness_now() - t0);
+                sigprocmask(SIG_SETMASK, &omask, NULL);
+                return -1;
+            }
+            ts.tv_sec = (time_t) t;
+            ts.tv_nsec = (long) (1E9 * (t - floor(t)));
+            sigtimedwait(&chld, NULL, &ts);
+        }
+        sigprocmask(SIG_SETMASK, &omask, NULL);
+    } else {
+        waitpid(p, &stat, 0);
+    }
     fflush(stdout);
 
     // normal exit ?